@@ -2,67 +2,210 @@
 #define _AST_H
 #include "Symbol.h"
 #include "Scope.h"
-#include "antlr4-runtime.h" 
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 namespace Ast{
 
-class AstNode{
+// index of a node in the AstArena that owns it
+using NodeId = uint32_t;
+
+// compact record of one node, everything it points to is a 32-bit index into its arena
+struct AstNode{
+    // token type using enums in VCalcParser.h
+    uint32_t type;
+
+    // interned text of the token, "" for imaginary nodes
+    uint32_t text;
+
+    // source position of the token, 0 for imaginary nodes
+    uint32_t line;
+    uint32_t column;
+
+    // children are child_count consecutive ids in the arena's child list starting at first_child
+    uint32_t first_child = 0;
+    uint32_t child_count = 0;
+
+    // symbol ast node references, expr will reference a type, 0 is none
+    uint32_t reference = 0;
+
+    // current scope (only really needs to be set for ast nodes that imply a scope change which is only BLOCK)
+    uint32_t scope = 0;
+
+    // vector EXPRs of one statement with the same nonzero length class have the same length, 0 is unknown
+    uint32_t length_class = 0;
+
+    // vector EXPR length found by LengthInference, -1 when it is only known at runtime. Vector sizes are i32 in
+    // codegen and vcalcrt so this is too
+    int32_t length = -1;
+};
+
+class AstArena;
+class Node;
+
+// children of a node, a view of the arena's child list so nothing is copied
+class NodeSpan{
     private:
-        // symbol ast node references (can be nullptr), expr will reference a type
-        std::shared_ptr<Symbol::BaseSymbol> reference;
+        AstArena *arena = nullptr;
+        // index in the child list rather than a pointer, the list may grow while the span is in use
+        uint32_t first = 0;
+        uint32_t count = 0;
 
-        // list of all children of the current ast node (amount differs depending on current node)
-        std::vector<std::shared_ptr<AstNode>> children; 
+    public:
+        class Iterator{
+            private:
+                AstArena *arena;
+                uint32_t index;
+
+            public:
+                Iterator(AstArena *arena, uint32_t index): arena(arena), index(index) {}
+                Node operator*() const;
+                Iterator &operator++() { ++index; return *this; }
+                bool operator!=(const Iterator &other) const { return index != other.index; }
+                bool operator==(const Iterator &other) const { return index == other.index; }
+        };
+
+        NodeSpan() = default;
+        NodeSpan(AstArena *arena, uint32_t first, uint32_t count): arena(arena), first(first), count(count) {}
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+        Node operator[](size_t i) const;
+        Iterator begin() const { return Iterator(arena, first); }
+        Iterator end() const { return Iterator(arena, first + count); }
+};
 
-        // pointer to corrosponding antr token for ast node
-        std::shared_ptr<antlr4::Token> token;
+// handle of a node in an AstArena. It is two words, passed by value and used with -> like the shared_ptr nodes were,
+// const only means the handle does not change, the node it refers to can still be modified through it
+class Node{
+    private:
+        AstArena *arena = nullptr;
+        NodeId id = 0;
 
-        // current scope (only really needs to be non-null for ast nodes that imply a scope change which is only BLOCK)
-        std::shared_ptr<Scope::BaseScope> scope;
+        AstNode &Record() const;
 
     public:
-        // constructor using enums tokens in VCalcParser.h
-        AstNode(size_t token_type);
+        Node() = default;
+        Node(AstArena *arena, NodeId id): arena(arena), id(id) {}
+
+        // lets node->GetText() keep working where the handle replaced a pointer
+        const Node *operator->() const { return this; }
+        explicit operator bool() const { return arena != nullptr; }
+        bool operator==(const Node &other) const { return id == other.id && arena == other.arena; }
+        bool operator!=(const Node &other) const { return !(*this == other); }
 
-        // constructor using just a token pointer (in visitor use for example ctx->ID()->getSymbol() for initialization)
-        AstNode(antlr4::Token* init_token);
+        NodeId GetId() const { return id; }
+        AstArena *GetArena() const { return arena; }
 
-        // returns children member
-        std::vector<std::shared_ptr<AstNode>> GetChildren(); 
+        // returns the children, valid until the node's children are replaced
+        NodeSpan GetChildren() const;
 
-        // takes return value from corrosponding AstBuilder visit methods and any casts it to call other AddChild method
-        void AddChild(std::any t);
+        // replaces all children, used by passes that rewrite nodes in place
+        void SetChildren(std::initializer_list<Node> new_children) const;
+        void SetChildren(NodeSpan new_children) const;
 
-        // adds child into children member
-        void AddChild(std::shared_ptr<AstNode> t); 
+        // returns node type using enums in VCalcParser.h
+        size_t GetNodeType() const;
 
-        // returns node type using token member
-        size_t GetNodeType();
+        // get text of the token the node was made from, "" for imaginary nodes
+        const std::string &GetText() const;
 
-        // get text associated with token using token member, if none return "nil" string
-        std::string GetText(); 
+        // interned id of the text, every node of the arena with the same text has the same id
+        uint32_t GetTextId() const;
 
-        // returns reference member
-        std::shared_ptr<Symbol::BaseSymbol> GetReference();
+        // returns parse line and column
+        size_t GetLine() const;
+        size_t GetColumn() const;
 
-        // sets reference member
-        void SetReference(std::shared_ptr<Symbol::BaseSymbol> new_reference);
+        const std::shared_ptr<Symbol::BaseSymbol> &GetReference() const;
+        void SetReference(std::shared_ptr<Symbol::BaseSymbol> new_reference) const;
+
+        const std::shared_ptr<Scope::BaseScope> &GetScope() const;
+        void SetScope(std::shared_ptr<Scope::BaseScope> new_scope) const;
+
+        int32_t GetLength() const;
+        void SetLength(int32_t new_length) const;
+        uint32_t GetLengthClass() const;
+        void SetLengthClass(uint32_t new_length_class) const;
+};
+
+// owns every node of one program in a single vector, along with their child lists, interned token texts and the
+// symbols and scopes they reference. Nodes live as long as the arena, which has to outlive every Node handle
+class AstArena{
+    private:
+        friend class Node;
+        friend class NodeSpan;
 
-        // sets scope member
-        void SetScope(std::shared_ptr<Scope::BaseScope> new_scope);
+        std::vector<AstNode> nodes;
 
-        std::shared_ptr<Scope::BaseScope> GetScope();
-        // returns parse token of node
-        std::shared_ptr<antlr4::Token> GetToken();
+        // child lists of all nodes back to back, a replaced list is left behind and a new one appended
+        std::vector<NodeId> children;
 
-        // returns parse line
-        size_t GetLine();
+        // every distinct token text once, a deque so the strings and the views of them in text_ids never move
+        std::deque<std::string> texts;
+        std::unordered_map<std::string_view, uint32_t> text_ids;
 
+        // symbols and scopes referenced by nodes, each once, index 0 is nullptr
+        std::vector<std::shared_ptr<Symbol::BaseSymbol>> references;
+        std::unordered_map<Symbol::BaseSymbol *, uint32_t> reference_ids;
+        std::vector<std::shared_ptr<Scope::BaseScope>> scopes;
+        std::unordered_map<Scope::BaseScope *, uint32_t> scope_ids;
 
+        NodeId root = 0;
 
+        uint32_t AppendChildren(const Node *first, size_t count);
+
+    public:
+        AstArena();
+
+        // returns the id of text, adding it the first time it is seen
+        uint32_t Intern(std::string_view text);
+
+        // makes a node from a token with no children
+        Node NewLeaf(size_t type, std::string_view text, size_t line, size_t column = 0);
+
+        // makes an imaginary node over children made before it
+        Node NewNode(size_t type, std::initializer_list<Node> node_children = {});
+        Node NewNode(size_t type, const std::vector<Node> &node_children);
+
+        size_t Size() const { return nodes.size(); }
+
+        Node GetRoot() { return Node(this, root); }
+        void SetRoot(Node new_root) { root = new_root.GetId(); }
 };
 
+inline Node NodeSpan::Iterator::operator*() const{
+    return Node(arena, arena->children[index]);
+}
+
+inline Node NodeSpan::operator[](size_t i) const{
+    return Node(arena, arena->children[first + i]);
+}
 
+inline AstNode &Node::Record() const{
+    return arena->nodes[id];
+}
+
+inline size_t Node::GetNodeType() const{
+    return Record().type;
+}
+
+inline NodeSpan Node::GetChildren() const{
+    const AstNode &record = Record();
+    return NodeSpan(arena, record.first_child, record.child_count);
+}
+
+}
+
+namespace std{
+template <> struct hash<Ast::Node>{
+    size_t operator()(const Ast::Node &node) const { return hash<Ast::NodeId>()(node.GetId()); }
+};
 }
 #endif
@@ -5,8 +5,20 @@
 
 namespace AstBuilder{
 
+// every visit method returns the Ast::NodeId of the node it made in arena, an id fits in std::any without allocating
 class AstBuild: public vcalc::VCalcBaseVisitor{
+    private:
+        Ast::AstArena &arena;
+
+        // visits a parse tree and returns the node it made
+        Ast::Node VisitNode(antlr4::tree::ParseTree *tree);
+
+        // makes a leaf node from a token
+        Ast::Node TokenNode(antlr4::tree::TerminalNode *terminal);
+
     public:
+        AstBuild(Ast::AstArena &arena): arena(arena) {}
+
         std::any visitFile(vcalc::VCalcParser::FileContext *ctx) override;
         std::any visitExpr(vcalc::VCalcParser::ExprContext *ctx) override;
         std::any visitStatement(vcalc::VCalcParser::StatementContext *ctx) override;
@@ -16,10 +28,10 @@ class AstBuild: public vcalc::VCalcBaseVisitor{
         std::any visitIf_stat(vcalc::VCalcParser::If_statContext *ctx) override;
         std::any visitLoop(vcalc::VCalcParser::LoopContext *ctx) override;
         std::any visitPrint(vcalc::VCalcParser::PrintContext *ctx) override;
-        std::any AddOperationNode(vcalc::VCalcParser::ExprContext *ctx);
-        std::any AddAssignNode(vcalc::VCalcParser::DeclarationContext *ctx);
+        Ast::Node AddOperationNode(vcalc::VCalcParser::ExprContext *ctx);
+        Ast::Node AddAssignNode(vcalc::VCalcParser::DeclarationContext *ctx);
 };
 
     
 }
-#endif
\ No newline at end of file
+#endif
@@ -4,6 +4,11 @@
 #include "BackEnd.h"
 #include "Scope.h"
 #include "VCalcParser.h"
+#include <unordered_map>
+#include <cstdint>
+#include <algorithm>
+#include "mlir/Transforms/RegionUtils.h"
+#include "llvm/ADT/SetVector.h"
 extern int program_flags;
 #define DEBUG 1
 
@@ -13,17 +18,17 @@ class AstWalker{
     protected:
         std::shared_ptr<Scope::BaseScope> current_scope;
     public:
-        virtual void Visit(std::shared_ptr<Ast::AstNode> current_node);
-        virtual void VisitChildren(std::shared_ptr<Ast::AstNode> current_node);
-        virtual void VisitBLOCK(std::shared_ptr<Ast::AstNode> current_node) = 0;
-        virtual void VisitIF_BLOCK(std::shared_ptr<Ast::AstNode> current_node) = 0;
-        virtual void VisitLOOP_BLOCK(std::shared_ptr<Ast::AstNode> current_node) = 0;
-        virtual void VisitDECL(std::shared_ptr<Ast::AstNode> current_node) = 0;
-        virtual void VisitASSIGN(std::shared_ptr<Ast::AstNode> current_node) = 0;
-        virtual void VisitEXPR(std::shared_ptr<Ast::AstNode> current_node) = 0;
-        virtual void VisitPRINT(std::shared_ptr<Ast::AstNode> current_node) = 0;
-        virtual void VisitID(std::shared_ptr<Ast::AstNode> current_node) = 0;
-        virtual void VisitINT(std::shared_ptr<Ast::AstNode> current_node) = 0;
+        virtual void Visit(Ast::Node current_node);
+        virtual void VisitChildren(Ast::Node current_node);
+        virtual void VisitBLOCK(Ast::Node current_node) = 0;
+        virtual void VisitIF_BLOCK(Ast::Node current_node) = 0;
+        virtual void VisitLOOP_BLOCK(Ast::Node current_node) = 0;
+        virtual void VisitDECL(Ast::Node current_node) = 0;
+        virtual void VisitASSIGN(Ast::Node current_node) = 0;
+        virtual void VisitEXPR(Ast::Node current_node) = 0;
+        virtual void VisitPRINT(Ast::Node current_node) = 0;
+        virtual void VisitID(Ast::Node current_node) = 0;
+        virtual void VisitINT(Ast::Node current_node) = 0;
 };
 
 class DefRef: public AstWalker{
@@ -38,50 +43,272 @@ class DefRef: public AstWalker{
 
     private:
         std::vector<std::tuple<std::unordered_set<size_t>, OperationType>> operation_to_type;
-        void VisitBLOCK(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitIF_BLOCK(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitLOOP_BLOCK(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitDECL(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitASSIGN(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitEXPR(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitPRINT(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitID(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitINT(std::shared_ptr<Ast::AstNode> current_node) override;
-        std::shared_ptr<Symbol::BuiltInTypeSymbol> GetBuiltInTypeData(const std::string& type);
+        void VisitBLOCK(Ast::Node current_node) override;
+        void VisitIF_BLOCK(Ast::Node current_node) override;
+        void VisitLOOP_BLOCK(Ast::Node current_node) override;
+        void VisitDECL(Ast::Node current_node) override;
+        void VisitASSIGN(Ast::Node current_node) override;
+        void VisitEXPR(Ast::Node current_node) override;
+        void VisitPRINT(Ast::Node current_node) override;
+        void VisitID(Ast::Node current_node) override;
+        void VisitINT(Ast::Node current_node) override;
+
+        // the built in types, defined in the global scope once and referenced by every typed EXPR
+        std::shared_ptr<Symbol::BuiltInTypeSymbol> int_type_symbol;
+        std::shared_ptr<Symbol::BuiltInTypeSymbol> vector_type_symbol;
 
 };
 
+// Folds constant int expressions, constant ranges, constant indexing and identities (x+0, x-0, x*1, x/1)
+// by rewriting EXPR nodes in place, runs after DefRef so every EXPR already has its type
+class ConstantFolder: public AstWalker{
+    public:
+        // returns true and sets value when node is an EXPR holding a single INT that fits in an int
+        static bool GetConstant(Ast::Node node, int32_t &value);
+    private:
+        void VisitBLOCK(Ast::Node current_node) override;
+        void VisitIF_BLOCK(Ast::Node current_node) override;
+        void VisitLOOP_BLOCK(Ast::Node current_node) override;
+        void VisitDECL(Ast::Node current_node) override;
+        void VisitASSIGN(Ast::Node current_node) override;
+        void VisitEXPR(Ast::Node current_node) override;
+        void VisitPRINT(Ast::Node current_node) override;
+        void VisitID(Ast::Node current_node) override;
+        void VisitINT(Ast::Node current_node) override;
+
+        // returns true and sets the bounds when node is a range between two constants
+        static bool GetConstantRange(Ast::Node node, int32_t &lower, int32_t &upper);
+
+        // computes lhs op rhs the way the generated code does, returns false when it would trap at runtime
+        static bool FoldIntOperation(size_t op, int32_t lhs, int32_t rhs, int32_t &result);
+
+        // rewrites node into an EXPR with a single INT child
+        static void ReplaceWithConstant(Ast::Node node, int32_t value);
+
+        // rewrites node into the range lower..upper, int_type is the type symbol of the bounds
+        static void ReplaceWithRange(Ast::Node node, Ast::Node dots_node,
+                                     int32_t lower, int32_t upper, std::shared_ptr<Symbol::BaseSymbol> int_type);
+
+        // rewrites node into a copy of other
+        static void ReplaceWith(Ast::Node node, Ast::Node other);
+
+        // returns true when value fits in an int
+        static bool FitsInt(int64_t value);
+};
+
+// Records the length of every vector EXPR, as a constant when it is known at compile time and as a length class
+// shared by the EXPRs of a statement that must have equal lengths. A vector variable keeps a constant length
+// across statements when every assignment to it has that length. Runs after ConstantFolder so ranges are folded.
+class LengthInference: public AstWalker{
+    public:
+        // runs the analysis over the whole program until the variable lengths stop changing
+        void Infer(Ast::Node root);
+
+    private:
+        void VisitBLOCK(Ast::Node current_node) override;
+        void VisitIF_BLOCK(Ast::Node current_node) override;
+        void VisitLOOP_BLOCK(Ast::Node current_node) override;
+        void VisitDECL(Ast::Node current_node) override;
+        void VisitASSIGN(Ast::Node current_node) override;
+        void VisitEXPR(Ast::Node current_node) override;
+        void VisitPRINT(Ast::Node current_node) override;
+        void VisitID(Ast::Node current_node) override;
+        void VisitINT(Ast::Node current_node) override;
+
+        // passes over the program before giving up on variable lengths
+        static constexpr int max_passes = 8;
+
+        // constant length of each vector variable, -1 once assignments disagree
+        std::unordered_map<Symbol::VarSymbol *, int64_t> variable_lengths;
+
+        // length class of each value shape seen in the current statement
+        std::unordered_map<std::string, uint32_t> statement_classes;
+        uint32_t next_class = 1;
+
+        // set when a variable length changed during the current pass
+        bool changed = false;
+
+        // returns the length class of key in the current statement, an empty key gets no class
+        uint32_t GetClass(const std::string &key);
+
+        // returns a key that is equal for two EXPRs of a statement with the same value, empty when there is none
+        std::string ShapeKey(Ast::Node node);
+
+        // records a compile time length on node
+        void SetKnownLength(Ast::Node node, int64_t length);
+
+        // copies the length of other onto node
+        static void CopyLength(Ast::Node node, Ast::Node other);
+
+        // merges the length of an assignment into the variable
+        void AssignLength(Symbol::VarSymbol *variable, int64_t length);
+
+        // returns the variable DefRef bound to an ID node
+        static Symbol::VarSymbol *GetVariable(Ast::Node id_node);
+
+        static bool IsVector(Ast::Node node);
+};
+
 class CodeGen: public AstWalker, public BackEnd{
     private:
         std::stack<mlir::Value> opperands;
-        void VisitBLOCK(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitIF_BLOCK(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitLOOP_BLOCK(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitDECL(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitASSIGN(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitEXPR(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitPRINT(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitID(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitINT(std::shared_ptr<Ast::AstNode> current_node) override;
+        void VisitBLOCK(Ast::Node current_node) override;
+        void VisitIF_BLOCK(Ast::Node current_node) override;
+        void VisitLOOP_BLOCK(Ast::Node current_node) override;
+        void VisitDECL(Ast::Node current_node) override;
+        void VisitASSIGN(Ast::Node current_node) override;
+        void VisitEXPR(Ast::Node current_node) override;
+        void VisitPRINT(Ast::Node current_node) override;
+        void VisitID(Ast::Node current_node) override;
+        void VisitINT(Ast::Node current_node) override;
+
+        // returns true for the int bool ops (LESS, GREATER, LOGEQ, LOGNEQ)
+        static bool IsIntBoolOperation(size_t op);
+
+        // stack slots of the vector variables, all allocated once in the entry block of main
+        std::vector<mlir::Value> frame;
+        // slot of each vector variable, variables of disjoint scopes share slots
+        std::unordered_map<Symbol::VarSymbol *, size_t> frame_slots;
+
+        // assigns slots to the vector variables declared under node, first_free is the first slot not used by an
+        // enclosing scope, frame_size is raised to the number of slots needed
+        void LayoutFrame(Ast::Node node, size_t first_free, size_t &frame_size);
+
+        // evaluates an int expr used as a branch condition and returns it as an i1
+        mlir::Value GenerateCondition(Ast::Node expr_node);
+
+        // int variables live in SSA values (VarSymbol::GetValue), returns the ones already declared that an
+        // assignment inside node may change, these are carried through block arguments around ifs and loops
+        std::vector<Symbol::VarSymbol *> CollectAssignedInts(Ast::Node node);
+
+        // collects the variables of any type already declared that an assignment inside node may change
+        void CollectAssigned(Ast::Node node, std::vector<Symbol::VarSymbol *> &variables);
+
+        // vector EXPRs computed once before the loop containing them and reused by every iteration, their
+        // consumers borrow them and the loop frees them on exit
+        std::unordered_map<Ast::Node, mlir::Value> hoisted;
+
+        // collects the largest vector EXPRs under node a loop that assigns the variables in assigned can hoist, only
+        // from code that runs on every iteration
+        void CollectLoopInvariants(Ast::Node node, Ast::Node parent,
+                                   const std::vector<Symbol::VarSymbol *> &assigned,
+                                   std::vector<Ast::Node> &invariants);
+
+        // returns true when node only reads variables declared before the loop that are not in assigned, or
+        // iterators it binds itself, and has no division that could trap when the loop would not have run it
+        bool IsLoopInvariant(Ast::Node node, const std::vector<Symbol::VarSymbol *> &assigned,
+                             std::vector<Symbol::VarSymbol *> bound);
+
+        // returns the current values of variables in order
+        static std::vector<mlir::Value> GetValues(const std::vector<Symbol::VarSymbol *> &variables);
+
+        // adds one int argument per variable to block and makes it the variable's value
+        void BindBlockArguments(mlir::Block *block, const std::vector<Symbol::VarSymbol *> &variables);
+
+        // a vector operand read element by element, a range that is only consumed is never materialized
+        // and keeps just its lower bound and size, vector and data are null for it
+        struct VectorView {
+            mlir::Value vector;
+            mlir::Value data;
+            mlir::Value lower;
+            mlir::Value size;
+        };
+
+        // returns true when node is a range expression lo..hi that is not hoisted
+        bool IsRange(Ast::Node node);
+
+        // evaluates a vector EXPR into a view, ranges stay lazy and everything else is visited as usual
+        VectorView GenerateVectorView(Ast::Node node);
+
+        // emits the element of view at an index known to be in bounds
+        mlir::Value GenerateViewElement(const VectorView &view, mlir::Value index);
+
+        // emits the element of view at any index, out of bounds indices read as 0 like vector_index
+        mlir::Value GenerateCheckedViewElement(const VectorView &view, mlir::Value index);
+
+        // emits an INDEX expr where either side is a range without materializing the range
+        mlir::Value GenerateLazyIndex(Ast::Node node);
+
+        // state for one fused element-wise EXPR tree, keyed by the ast nodes of the tree
+        struct FusedTree {
+            Ast::Node root;
+            // leaves are evaluated before the loop, view.size is null for int leaves
+            struct Leaf {
+                mlir::Value value;
+                VectorView view;
+                // the leaf is a temporary vector freed once the loop is done
+                bool owned = false;
+            };
+            std::unordered_map<Ast::Node, Leaf> leaves;
+            // runtime size of every vector node in the tree
+            std::unordered_map<Ast::Node, mlir::Value> sizes;
+        };
+
+        // returns true when the vector value of node is a fresh allocation that its consumer has to free,
+        // a vector variable read through an ID or a hoisted vector is borrowed
+        bool IsOwnedVector(Ast::Node node);
+
+        // frees value, the result of node, once it has been consumed if node produced an owned vector
+        void FreeIfOwned(Ast::Node node, mlir::Value value);
+
+        // returns true when length inference proved left and right have the same length
+        static bool SameLength(Ast::Node left, Ast::Node right);
+
+        // returns true for vector EXPR nodes with an arithmetic or bool op, these can be computed per element
+        bool IsElementWise(Ast::Node node);
+
+        // returns the number of element-wise ops that fuse into node
+        size_t CountElementWise(Ast::Node node);
+
+        // emits a single loop computing the whole element-wise tree at node per index, returns the result vector
+        mlir::Value GenerateFusedExpr(Ast::Node node);
+
+        // evaluates the leaves of a fused tree in order and computes the size of each vector node
+        void CollectFusedLeaves(Ast::Node node, FusedTree &tree);
+
+        // emits the scf.for writing every element of the fused tree into result_arr_ptr
+        void GenerateFusedLoop(FusedTree &tree, Ast::Node node, mlir::Value result_arr_ptr, mlir::Value size, bool guarded);
+
+        // emits the value of node at index, guarded elements past a vector's size read as padding_value
+        mlir::Value GenerateFusedElement(FusedTree &tree, Ast::Node node, mlir::Value index, bool guarded, int padding_value);
+
+        // domains with at least this many elements are handed to the vcalcrt thread pool, the smallest it splits
+        static constexpr int parallel_threshold = 8192;
+
+        // threads the compiled program asks vcalcrt for, 0 leaves it to VCALC_NUM_THREADS
+        int num_threads = 0;
+
+        // number of generator and filter loops outlined so far, names them uniquely
+        size_t outlined_loops = 0;
+
+        // outlines the loop of the GENERATOR or FILTER EXPR node over the domain indices [begin, end) into a function
+        // with the vcalcrt_generator_fn or vcalcrt_filter_fn signature. Values the body reads from the enclosing
+        // function are packed into env at the current insertion point, env is null when there are none.
+        mlir::LLVM::LLVMFuncOp OutlineGeneratorLoop(Ast::Node node, const VectorView &domain,
+                                                    mlir::Value result_arr_ptr, mlir::Value &env);
     public:
-        void GenerateMlir(bool dump, std::shared_ptr<Ast::AstNode> current_node);
-        CodeGen();
+        void GenerateMlir(bool dump, Ast::Node current_node);
+        // makes the compiled program run parallel loops on threads threads regardless of VCALC_NUM_THREADS
+        void SetNumThreads(int threads);
+        // drops the current program so the next GenerateMlir starts fresh, see BackEnd::Reset
+        void Reset();
+        explicit CodeGen(const std::string &prelude_path = "", bool reusable = false);
 
 };
 
 class AstDebugger: public AstWalker{
     public:
-        void VisitBLOCK(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitIF_BLOCK(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitLOOP_BLOCK(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitDECL(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitASSIGN(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitEXPR(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitPRINT(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitID(std::shared_ptr<Ast::AstNode> current_node) override;
-        void VisitINT(std::shared_ptr<Ast::AstNode> current_node) override;
-        void ExprPrintOp(std::shared_ptr<Ast::AstNode> current_node);
-        void DfsTraversal(std::shared_ptr<Ast::AstNode> current_node);
+        void VisitBLOCK(Ast::Node current_node) override;
+        void VisitIF_BLOCK(Ast::Node current_node) override;
+        void VisitLOOP_BLOCK(Ast::Node current_node) override;
+        void VisitDECL(Ast::Node current_node) override;
+        void VisitASSIGN(Ast::Node current_node) override;
+        void VisitEXPR(Ast::Node current_node) override;
+        void VisitPRINT(Ast::Node current_node) override;
+        void VisitID(Ast::Node current_node) override;
+        void VisitINT(Ast::Node current_node) override;
+        void ExprPrintOp(Ast::Node current_node);
+        void DfsTraversal(Ast::Node current_node);
 };
 
     
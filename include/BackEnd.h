@@ -15,6 +15,29 @@
 #include "mlir/Target/LLVMIR/Export.h"
 #include "llvm/Support/raw_os_ostream.h"
 
+// LLVM optimization
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/FileSystem.h"
+
+// Prelude
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+#include "mlir/Target/LLVMIR/TypeFromLLVM.h"
+
+// JIT
+#include "mlir/ExecutionEngine/ExecutionEngine.h"
+#include "mlir/ExecutionEngine/OptUtils.h"
+
 // MLIR IR
 #include "mlir/IR/BuiltinAttributes.h"
 #include "mlir/IR/TypeRange.h"
@@ -33,6 +56,9 @@
 #include "mlir/Dialect/LLVMIR/FunctionCallUtils.h"
 
 // Other
+#include <functional>
+#include <map>
+#include <vector>
 #include <assert.h>
 #include "VCalcParser.h"
 #include "Type.h"
@@ -44,11 +70,35 @@ enum BackendMLIRType {
 
 class BackEnd {
     public:
-        BackEnd();
+        // The helper functions (vector ops, printing, ranges, ...) are declared from the bitcode prelude at
+        // prelude_path and linked in after translation, without one they are built as MLIR. Either way only the
+        // helpers GetHelper is asked for end up in the module.
+        // A reusable BackEnd keeps a copy of the helper functions so Reset can start a new program without
+        // rebuilding them, see Reset
+        explicit BackEnd(const std::string &prelude_path = "", bool reusable = false);
+
+        // Drops the current program and starts over from the helper functions built by the constructor, reusing
+        // the MLIR context and its loaded dialects. Only valid on a reusable BackEnd.
+        void Reset();
 
         int emitModule();
         int lowerDialects();
+        // Translates the lowered module into llvm_module
+        int translateToLLVM();
+        // Runs the LLVM default pipeline for opt_level (0-3) over llvm_module, 0 leaves it untouched
+        int optimizeLLVM(unsigned int opt_level);
         void dumpLLVM(std::ostream &os);
+        // Compiles llvm_module to a native object file at path
+        int emitObject(const std::string &path);
+        // Targets the CPU vcalc runs on with all of its features (eg AVX2, AVX-512) instead of a generic CPU,
+        // must be called before optimizing or emitting
+        void UseHostCPU();
+        // Lowers and writes the helper functions to path as LLVM bitcode, the prelude later compilations link against.
+        // Only valid on a BackEnd built without a prelude and before emitModule.
+        int emitPrelude(const std::string &path);
+        // JIT compiles the lowered module at opt_level (0-3) and runs main in this process, returning its exit code.
+        // runtime_path is the vcalcrt shared library to load first so its symbols resolve, empty runs without it.
+        int runJIT(unsigned int opt_level, const std::string &runtime_path);
         mlir::ModuleOp GetModule();
         mlir::Location GetLocation();
         std::shared_ptr<mlir::OpBuilder> GetBuilder();
@@ -57,15 +107,47 @@ class BackEnd {
         void PrintChar(char c);
         std::string GetOperationFunc(size_t op, size_t data_type);
 
+        // Emits an int arithmetic op (ADD, SUB, MUL, DIV) from VCalcParser.h at the current insertion point
+        mlir::Value CreateIntArithmetic(size_t op, mlir::Value lhs, mlir::Value rhs);
+
+        // Emits the i1 predicate of an int bool op (LESS, GREATER, LOGEQ, LOGNEQ) from VCalcParser.h at the current insertion point
+        mlir::Value CreateIntPredicate(size_t op, mlir::Value lhs, mlir::Value rhs);
+
+        // Emits an int bool op (LESS, GREATER, LOGEQ, LOGNEQ) from VCalcParser.h as a 0/1 int at the current insertion point
+        mlir::Value CreateIntBoolean(size_t op, mlir::Value lhs, mlir::Value rhs);
+
+        // Emits any int arithmetic or bool op from VCalcParser.h at the current insertion point
+        mlir::Value CreateIntOperation(size_t op, mlir::Value lhs, mlir::Value rhs);
+
+        // Returns the name of the vector/int function for op, eg vector_add_int or int_add_vector when scalar_lhs
+        std::string GetScalarOperationFunc(size_t op, bool scalar_lhs);
+
+        // Returns the extern_weak declaration of a vcalcrt function, declaring it on first use. It returns void
+        // unless result_type is given. Its address is null when the program is not linked against vcalcrt.
+        mlir::LLVM::LLVMFuncOp GetRuntimeFunction(const std::string &name, llvm::ArrayRef<mlir::Type> arg_types,
+                                                  mlir::Type result_type = mlir::Type());
+
+        // Returns the helper function name (eg vector_add, vector_mul_int, print_vector), emitting it into the module the
+        // first time it is asked for. From the prelude only its declaration is emitted.
+        mlir::LLVM::LLVMFuncOp GetHelper(const std::string &name);
+
+        // Erases the helpers nothing calls anymore, run once codegen is done
+        void EraseUnusedHelpers();
+
+        // Emits an i1 which is true when the program is linked against the vcalcrt function func
+        mlir::Value GenerateRuntimeLinked(mlir::LLVM::LLVMFuncOp func);
+
     
     protected:
         void setupPrintf();
         void createGlobalString(const char *str, const char *string_name);
-        // Generates an MLIR int arithmetic function for a given arithmetic op (ADD, SUB, MUL, DIV) from VCalcParser.h
-        void CreateIntArithmeticOperation(size_t op);
-
         // Generates an MLIR vector function for a given op from (ADD, SUB, MUL, DIV, LOQEQ, NLOQEQ, LESS, GREATER)  VCalcParser.h
-        void CreateVectorOperationFunction(size_t op);
+        // The unchecked variant (eg vector_add_unchecked) assumes both vectors have the same size and skips match_vector_size
+        void CreateVectorOperationFunction(size_t op, bool unchecked);
+
+        // Generates an MLIR function for op between a vector and an int which broadcasts the int instead of promoting it
+        // to a vector first, the int is the first argument when scalar_lhs
+        void CreateVectorScalarOperationFunction(size_t op, bool scalar_lhs);
 
         // Generates an MLIR vector function which promotes an int to a vector
         void CreateIntToVectorFunction();
@@ -74,12 +156,40 @@ class BackEnd {
 
         mlir::MLIRContext context;
         mlir::ModuleOp module;
+        // pristine copy of the helper functions, only kept by a reusable BackEnd
+        mlir::ModuleOp helper_module;
+
+        // bitcode the helpers are linked from, empty when they are built into module
+        std::string prelude_path;
+
+        // Builds each helper function as MLIR into module, keyed by its name
+        std::map<std::string, std::function<void()>> helper_builders;
+
+        // Signatures of the helper functions the prelude defines, keyed by name
+        std::map<std::string, mlir::LLVM::LLVMFunctionType> prelude_signatures;
+
+        // Fills helper_builders
+        void RegisterHelpers();
+
+        // Reads the helper signatures of the prelude at path into prelude_signatures, returns non zero if it cannot be read
+        int ReadPrelude(const std::string &path);
+
+        // Links the prelude helpers target calls into target and internalizes them, returns non zero on failure
+        int LinkPrelude(llvm::Module &target);
         std::shared_ptr<mlir::OpBuilder> builder;
         mlir::Location loc;
 
         // LLVM 
         llvm::LLVMContext llvm_context;
         std::unique_ptr<llvm::Module> llvm_module;
+        std::unique_ptr<llvm::TargetMachine> target_machine;
+
+        // Creates target_machine for the host triple, used so the optimizer has real target info
+        int CreateTargetMachine();
+
+        // CPU and feature string target_machine is created with, see UseHostCPU
+        std::string target_cpu = "generic";
+        std::string target_features;
 
         // Types
         mlir::Type vector_type, int_type, ptr_type;
@@ -93,13 +203,23 @@ class BackEnd {
         // Generates an MLIR func which returns an empty vector* with size arr_size
         mlir::Value GenerateVectorTypePtr(mlir::Value arr_size);
 
-        void CreateCastBoolToInt();
+        // Emits a null pointer, the value of a vector variable that holds nothing yet
+        mlir::Value GenerateNullPtr();
+
+        // Emits a realloc of a vector down to arr_size elements, the size header must already be updated
+        mlir::Value ShrinkVector(mlir::Value vector_ptr, mlir::Value arr_size);
+
+        // Emits a free of a vector allocated by GenerateVectorTypePtr, null is ignored
+        void FreeVector(mlir::Value vector_ptr);
+
+        // Generates an MLIR vector function which copies a vector
+        void CreateVectorCopyFunction();
 
         // Generates an MLIR vector function which prints a vector
         void CreatePrintVectorOperation();
 
-        // Generates an MLIR int bool function for a given op (LOQEQ, NLOQEQ, LESS, GREATER) from VCalcParser.h
-        void CreateIntBooleanOperation(size_t op);
+        // Generates an MLIR function which prints an int followed by a new line
+        void CreatePrintIntOperation();
 
         // Generates a int pointer which points an int with given value
         mlir::Value CreateIntPointer(mlir::Value value);
@@ -145,6 +265,12 @@ class VectorLoopMLIRFunction {
         // and calls LoopFunc at each iteration
         void Generate(BackEnd* backEnd, mlir::LLVM::LLVMFuncOp func, mlir::Value vector_ptr,mlir::Value upper_bound);
     protected:
+        // Vectors with at least this many elements are handed to the vcalcrt kernel when there is one
+        static constexpr int runtime_kernel_threshold = 256;
+        // Name of the vcalcrt kernel computing the whole loop, empty when the loop has none
+        virtual std::string RuntimeKernelName(BackEnd *backend);
+        // Kernel arguments between the result array and the element count
+        virtual std::vector<mlir::Value> RuntimeKernelArgs();
         // Called prior to MLIR loop
         virtual void PreHeaderFunc(BackEnd* backend);
         // Called at each iteration of the MLIR loop
@@ -162,6 +288,8 @@ class IntVectorPromotionFunction : public VectorLoopMLIRFunction{
         void PreHeaderFunc(BackEnd* backend) override;
         void LoopFunc(BackEnd *backend, mlir::Value i_value, mlir::Value arr_ptr, mlir::Value arr_size,
                     mlir::LLVM::LLVMFuncOp func) override;
+        std::string RuntimeKernelName(BackEnd *backend) override;
+        std::vector<mlir::Value> RuntimeKernelArgs() override;
     private:
         mlir::Value const_value;
         mlir::LLVM::LLVMFuncOp printfFunc;
@@ -177,6 +305,8 @@ class RangeVectorFunction : public VectorLoopMLIRFunction {
     protected:
         void LoopFunc(BackEnd *backend, mlir::Value i_value, mlir::Value arr_ptr, mlir::Value arr_size,
                     mlir::LLVM::LLVMFuncOp func) override;
+        std::string RuntimeKernelName(BackEnd *backend) override;
+        std::vector<mlir::Value> RuntimeKernelArgs() override;
     private:
         mlir::Value lower_bound;
 };
@@ -192,12 +322,35 @@ class VectorArithmeticOperationFunction : public VectorLoopMLIRFunction {
 
     protected:
         void LoopFunc(BackEnd *backend, mlir::Value i_value, mlir::Value arr_ptr, mlir::Value arr_size,mlir::LLVM::LLVMFuncOp func) override;
+        std::string RuntimeKernelName(BackEnd *backend) override;
+        std::vector<mlir::Value> RuntimeKernelArgs() override;
     private:
         size_t op;
         mlir::Value arr0_ptr;
         mlir::Value arr1_ptr;
 };
 
+// Generates a MLIR loop which performs any op between each element of a vector and a single int
+class VectorScalarOperationFunction : public VectorLoopMLIRFunction {
+    public:
+        explicit VectorScalarOperationFunction(size_t op, mlir::Value vector_arr_ptr, mlir::Value scalar, bool scalar_lhs) {
+            this->op = op;
+            this->vector_arr_ptr = vector_arr_ptr;
+            this->scalar = scalar;
+            this->scalar_lhs = scalar_lhs;
+        }
+
+    protected:
+        void LoopFunc(BackEnd *backend, mlir::Value i_value, mlir::Value arr_ptr, mlir::Value arr_size,mlir::LLVM::LLVMFuncOp func) override;
+        std::string RuntimeKernelName(BackEnd *backend) override;
+        std::vector<mlir::Value> RuntimeKernelArgs() override;
+    private:
+        size_t op;
+        mlir::Value vector_arr_ptr;
+        mlir::Value scalar;
+        bool scalar_lhs;
+};
+
 // Generates a MLIR loop which prints the value of a vector at each iteration
 class VectorPrintFunction : public VectorLoopMLIRFunction {
     protected:
@@ -220,10 +373,9 @@ class VectorBooleanOperationFunction : public VectorLoopMLIRFunction {
     protected:
         void LoopFunc(BackEnd *backend, mlir::Value i_value, mlir::Value arr_ptr, mlir::Value arr_size,mlir::LLVM::LLVMFuncOp func) override;
 
-        void PreHeaderFunc(BackEnd *backend) override;
-
+        std::string RuntimeKernelName(BackEnd *backend) override;
+        std::vector<mlir::Value> RuntimeKernelArgs() override;
     private:
-        mlir::LLVM::LLVMFuncOp bool_int_func;
         size_t op;
         mlir::Value arr0_ptr;
         mlir::Value arr1_ptr;
@@ -0,0 +1,50 @@
+#ifndef _COMPILECACHE_H
+#define _COMPILECACHE_H
+#include <string>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace CompileCache{
+
+// Version of the cache key and entry layout, the compiler itself is identified by its build id and prelude
+#define VCALC_CACHE_VERSION "vcalc-2"
+
+// On-disk cache of compiled artifacts keyed by a hash of the source text, the compiler build and the flags that
+// change the output. Entries are written to a temporary file and renamed into place so readers never see a partial
+// artifact. A hit refreshes the entry's modification time and the oldest entries are evicted once the total size
+// goes over the bound, so the cache behaves as an LRU.
+class Cache{
+    private:
+        std::filesystem::path directory;
+        uintmax_t max_bytes;
+
+        // path of the entry for key
+        std::filesystem::path EntryPath(const std::string &key);
+
+        // removes the least recently used entries until the cache fits in max_bytes
+        void Evict();
+
+    public:
+        Cache(const std::string &directory, uintmax_t max_bytes);
+
+        // returns the hex SHA-256 of the contents of the files at paths, skipping empty paths, or "" when one of
+        // them cannot be read
+        static std::string HashFiles(const std::vector<std::string> &paths);
+
+        // returns the GNU build id the linker stored in the running executable in hex, "" when it has none. It
+        // changes with every rebuild of vcalc and costs nothing to read, unlike hashing the executable
+        static std::string BuildId();
+
+        // returns the hex SHA-256 of the compiler build identity, the options and the source text
+        static std::string Key(const std::string &compiler, const std::string &source, const std::string &options);
+
+        // copies the entry for key to output_path, returns false on a miss
+        bool Fetch(const std::string &key, const std::string &output_path);
+
+        // stores the artifact at artifact_path under key, failures only cost the cache entry
+        void Store(const std::string &key, const std::string &artifact_path);
+};
+
+}
+#endif
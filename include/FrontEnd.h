@@ -0,0 +1,128 @@
+#ifndef _FRONTEND_H
+#define _FRONTEND_H
+#include "Ast.h"
+#include "VCalcParser.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ostream>
+
+// Hand written lexer and parser for the VCalc grammar that build the AST directly, without an ANTLR parse tree or a
+// copied token per node. Token types are the ones generated into VCalcParser.h so the AST is the same as the one
+// AstBuilder makes, and syntax errors are reported with the messages of ANTLR's ConsoleErrorListener.
+namespace FrontEnd{
+
+// set of token types as a bit per type, <EOF> is bit 0 which no other token type uses
+using TokenSet = uint64_t;
+
+struct Token{
+    size_t type;
+    // points into the source held by the Lexer
+    std::string_view text;
+    size_t line;
+    size_t column;
+};
+
+// returns the name ANTLR shows for token type in syntax errors, eg 'print(' or ID
+std::string TokenDisplayName(size_t type);
+
+// prints the tree rooted at node one node per line, children indented below their parent
+void DumpAst(Ast::Node node, std::ostream &os, size_t depth = 0);
+
+class Lexer{
+    private:
+        std::string source;
+        size_t position = 0;
+        size_t line = 1;
+        size_t column = 0;
+
+        // returns the number of bytes of the utf-8 encoded character at position
+        size_t CharLength();
+
+        // consumes one character, keeping line and column in characters like ANTLR does
+        void Consume();
+
+        // reports the characters from start up to position (and the one there, which is dropped too) like a
+        // LexerNoViableAltException
+        void ReportError(size_t start, size_t start_line, size_t start_column);
+
+    public:
+        Lexer(std::string source);
+
+        // lexes the whole source, dropping and reporting characters no token matches like the ANTLR lexer does
+        std::vector<Token> Tokenize();
+};
+
+class Parser{
+    private:
+        std::vector<Token> tokens;
+        size_t current = 0;
+
+        // arena the nodes are made in
+        Ast::AstArena &arena;
+
+        // text of tokens made up by error recovery, eg <missing ID>
+        std::deque<std::string> conjured_text;
+
+        // set by a reported syntax error and cleared by the next token matched, errors in between are not reported
+        bool error_recovery = false;
+
+        // index of the '[' of the outermost generator or filter that is not yet known to be either, ANTLR predicts
+        // which one it is before parsing it so any error until the '|' or '&' is a no viable alternative error
+        size_t pending_prediction = SIZE_MAX;
+
+        // error_recovery when the pending prediction started, a failed prediction is not reported if it was set
+        bool prediction_recovery = false;
+
+        // token that ends the block being parsed, <EOF>, 'fi' or 'pool'
+        size_t block_end = antlr4::Token::EOF;
+
+        const Token &LA(size_t i);
+
+        // consumes the current token, it was matched so error recovery is over
+        void Advance();
+
+        void ReportError(const Token &token, const std::string &message);
+
+        // reports an error that cannot be recovered from and throws
+        [[noreturn]] void Fail(const Token &token, const std::string &message);
+
+        // reports an error for the token where a generator or filter prediction failed and throws
+        [[noreturn]] void FailPrediction();
+
+        // matches a token of type, recovering like ANTLR by deleting one extraneous token or by assuming a missing
+        // one is there when the next token can follow it (follow)
+        Token Match(size_t type, TokenSet follow);
+
+        // makes a leaf node from a token, its text is interned so nothing points into the source afterwards
+        Ast::Node TokenNode(const Token &token);
+
+        Ast::Node ParseBlock();
+        Ast::Node ParseStatement();
+        Ast::Node ParseDeclaration();
+        Ast::Node ParseAssignment();
+        Ast::Node ParseConditional(size_t node_type, size_t end_type);
+        Ast::Node ParsePrint();
+
+        // parses operators of at least min_precedence by precedence climbing, expr_follow are the tokens that may
+        // follow the whole expression
+        Ast::Node ParseExpr(int min_precedence, TokenSet expr_follow);
+        Ast::Node ParsePrimary(TokenSet expr_follow);
+        Ast::Node ParseGenerator(TokenSet expr_follow);
+
+    public:
+        Parser(std::vector<Token> tokens, Ast::AstArena &arena);
+
+        // parses a whole file into arena and returns its BLOCK, throws std::runtime_error on errors it cannot
+        // recover from
+        Ast::Node ParseFile();
+};
+
+// lexes and parses the file at input_path, the arena's root is its BLOCK
+std::unique_ptr<Ast::AstArena> ParseFile(const std::string &input_path);
+
+}
+#endif
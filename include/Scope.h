@@ -1,17 +1,18 @@
 #ifndef _SCOPE_H
 #define _SCOPE_H
 #include "Symbol.h"
+#include "llvm/ADT/DenseMap.h"
+#include <cstdint>
 #include <string>
-#include <map>
 #include <memory>
 #include <iostream>
 namespace Scope{
 
 class BaseScope: public std::enable_shared_from_this<BaseScope>{
     private:
-        // member that represents all the symbols in the scope, is a map so requires you give as input the symbol
-        // name then the corrosponding symbol object is returned (Resolve can be used for this)
-        std::map<std::string, std::shared_ptr<Symbol::BaseSymbol>> symbols; // symbol name is gotten by getText method on corrosponding antr4 token
+        // member that represents all the symbols in the scope, a flat hash table keyed by the symbol's name id
+        // (the name interned by the AST arena, see Ast::Node::GetTextId) so no lookup compares strings
+        llvm::DenseMap<uint32_t, std::shared_ptr<Symbol::BaseSymbol>> symbols;
 
         // member thats represents the scope that encloses current scope
         std::shared_ptr<BaseScope> enclosing_scope;
@@ -21,19 +22,22 @@ class BaseScope: public std::enable_shared_from_this<BaseScope>{
         // (in the case of VCalc this should only be the BLOCK node)
         BaseScope(std::shared_ptr<BaseScope> init_scope): enclosing_scope(init_scope) {}
 
-        // adds a symbol to the scope
-        virtual void Define(std::shared_ptr<Symbol::BaseSymbol> sym);
+        // adds a symbol named name_id to the scope
+        virtual void Define(uint32_t name_id, std::shared_ptr<Symbol::BaseSymbol> sym);
 
         // returns the enclosing_scope member
         virtual std::shared_ptr<BaseScope> GetEnclosingScope();
 
-        std::map<std::string, std::shared_ptr<Symbol::BaseSymbol>> GetSymbols();
+        const llvm::DenseMap<uint32_t, std::shared_ptr<Symbol::BaseSymbol>> &GetSymbols();
 
         // sets new enclosing scope
         virtual void SetEnclosingScope(std::shared_ptr<BaseScope> new_enclosing_scope);
 
-        // resolve symbol with name in current scope and all enclosing scopes
-        virtual std::shared_ptr<Symbol::BaseSymbol> Resolve(const std::string &name);
+        // resolve symbol with name_id in current scope and all enclosing scopes
+        virtual std::shared_ptr<Symbol::BaseSymbol> Resolve(uint32_t name_id);
+
+        // resolve symbol with name_id in the current scope only, nullptr when it is not declared here
+        std::shared_ptr<Symbol::BaseSymbol> ResolveLocal(uint32_t name_id);
 
         // prints only the current scope and the names of all symbols in it, used for debugging if necessary
         virtual void PrintScope();
@@ -5,17 +5,129 @@
 #include "CommonTokenStream.h"
 #include "tree/ParseTree.h"
 #include "tree/ParseTreeWalker.h"
+#include "BailErrorStrategy.h"
+#include "ConsoleErrorListener.h"
+#include "DefaultErrorStrategy.h"
+#include "Exceptions.h"
+#include "atn/ParserATNSimulator.h"
+#include "atn/PredictionMode.h"
 
 #include "BackEnd.h"
 #include "AstBuilder.h"
+#include "FrontEnd.h"
 #include "Ast.h"
 #include "AstVisitor.h"
+#include "CompileCache.h"
 
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <iostream>
 #include <fstream>
+#include <vector>
+#include <cstring>
+#include <sstream>
 
 int program_flags = 0;
 #define DEBUG 1
 
-void SetFlags(int argc, char **argv);
+// LLVM optimization level set by -O0..-O3
+unsigned int opt_level = 0;
+
+// run the program through the JIT instead of writing LLVM IR, set by --run
+bool run_jit = false;
+
+// output kind set by --emit=ll|obj|exe, LLVM IR text by default
+std::string emit_kind = "ll";
+
+// target the host CPU and its features, set by -march=native
+bool march_native = false;
+
+// threads the compiled program runs large generators and filters on, set by --threads=<n>, 0 leaves it to the
+// VCALC_NUM_THREADS environment variable of the program
+int num_threads = 0;
+
+// path the helper function prelude is written to, set by --emit-prelude=<path> at build time
+std::string prelude_output;
+
+// print how long lexing and parsing took and which prediction mode succeeded to stderr, set by --parse-time
+bool report_parse_time = false;
+
+// lex and parse with the hand written FrontEnd instead of ANTLR, set by --frontend=handwritten
+bool handwritten_frontend = false;
+
+// print the AST of the input as parsed and exit, set by --dump-ast
+bool dump_ast = false;
+
+// compile every input/output pair concurrently, set by --batch
+bool batch = false;
+
+// worker threads of --batch set by --jobs=<n>, 0 uses one per CPU
+int jobs = 0;
+
+// compile cache directory set by --cache-dir=<dir>, empty disables the cache
+std::string cache_dir;
+
+// build id of the vcalc executable and hash of its prelude, found once when the cache is enabled, part of every
+// cache key
+std::string compiler_identity;
+
+// size bound of the compile cache in MiB set by --cache-size=<MiB>
+uintmax_t cache_size_mib = 256;
+
+// sets program_flags, opt_level, run_jit, prelude_output, report_parse_time, handwritten_frontend, dump_ast, batch, jobs, num_threads, the output options and the cache options, returns the remaining positional
+// arguments in order
+std::vector<char *> SetFlags(int argc, char **argv);
+
+// returns the value of env_var if set, otherwise the path of file_name next to the vcalc executable, empty when
+// there is none
+std::string FindNextToExecutable(const char *argv0, const char *env_var, const char *file_name);
+
+// returns the path of the vcalcrt shared library for --run and --emit=exe, VCALCRT_PATH if set, otherwise the library
+// next to the vcalc executable, otherwise the one in the build tree vcalc was built with, empty when there is none
+std::string FindRuntimeLibrary(const char *argv0);
+
+// returns the path of the helper function prelude, VCALC_PRELUDE if set, otherwise the one generated next to the
+// vcalc executable at build time, empty when there is none and the helpers are built on every compilation
+std::string FindPrelude(const char *argv0);
+
+// returns the flags that change the generated artifact, part of the compile cache key. runtime_path is linked into
+// and baked into the rpath of --emit=exe outputs, so it is one of them
+std::string CacheOptions(const std::string &runtime_path);
+
+// returns the build id of vcalc and the hash of its prelude, identifying this build, empty when they cannot be read
+std::string CompilerIdentity(const char *argv0);
+
+// links object_path into the executable output_path with the system C compiler driver, against vcalcrt when
+// runtime_path is not empty, returns non zero on failure
+int LinkExecutable(const std::string &object_path, const std::string &output_path, const std::string &runtime_path);
+// lexes and parses input_path with the selected frontend and returns the arena holding the AST before any pass
+std::unique_ptr<Ast::AstArena> BuildAst(const std::string &input_path);
+
+// parses input_path and runs every AST pass before code generation, throws std::runtime_error on invalid programs.
+// The arena owns the nodes and has to outlive code generation from its root
+std::unique_ptr<Ast::AstArena> ParseFile(const std::string &input_path);
+
+// translates, optimizes and writes the lowered module of code_gen_visitor to output_path as the --emit kind,
+// returns non zero on failure
+int EmitArtifact(AstVisitor::CodeGen &code_gen_visitor, const std::string &output_path, const std::string &runtime_path);
+
+// compiles input_path to output_path with code_gen_visitor, going through the compile cache when it is enabled,
+// dump prints the generated MLIR, returns non zero on failure
+int CompileFile(AstVisitor::CodeGen &code_gen_visitor, const std::string &input_path, const std::string &output_path,
+                const std::string &runtime_path, bool dump);
+
+// returns the input/output pairs of --batch, read one pair per line from a list file when args is a single path
+std::vector<std::pair<std::string, std::string>> BatchFiles(const std::vector<char *> &args);
+
+// compiles files on --jobs worker threads that each reuse one CodeGen, reports every file that failed on stderr
+// and returns non zero if any did
+int CompileBatch(const std::vector<std::pair<std::string, std::string>> &files, const std::string &prelude_path,
+                 const std::string &runtime_path);
 int main(int argc, char **argv);
\ No newline at end of file
@@ -0,0 +1,88 @@
+#ifndef _VCALCRT_H
+#define _VCALCRT_H
+#include <stdint.h>
+
+// VCalc runtime library. Generated code declares these symbols extern_weak and only calls them when the
+// library is linked in, otherwise it falls back to the loops it emits itself.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Element-wise vector kernels over raw int buffers of n elements (the data part of a vector, not its size header).
+// Bool kernels write 0/1. Division by zero or INT32_MIN / -1 behaves exactly like the scalar division it replaces.
+void vcalcrt_vector_add(int32_t *out, const int32_t *lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_vector_sub(int32_t *out, const int32_t *lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_vector_mul(int32_t *out, const int32_t *lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_vector_div(int32_t *out, const int32_t *lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_vector_less_than(int32_t *out, const int32_t *lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_vector_greater_than(int32_t *out, const int32_t *lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_vector_equal(int32_t *out, const int32_t *lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_vector_nequal(int32_t *out, const int32_t *lhs, const int32_t *rhs, int32_t n);
+
+// Vector op int kernels, the int is broadcast to every element
+void vcalcrt_vector_add_int(int32_t *out, const int32_t *lhs, int32_t rhs, int32_t n);
+void vcalcrt_vector_sub_int(int32_t *out, const int32_t *lhs, int32_t rhs, int32_t n);
+void vcalcrt_vector_mul_int(int32_t *out, const int32_t *lhs, int32_t rhs, int32_t n);
+void vcalcrt_vector_div_int(int32_t *out, const int32_t *lhs, int32_t rhs, int32_t n);
+void vcalcrt_vector_less_than_int(int32_t *out, const int32_t *lhs, int32_t rhs, int32_t n);
+void vcalcrt_vector_greater_than_int(int32_t *out, const int32_t *lhs, int32_t rhs, int32_t n);
+void vcalcrt_vector_equal_int(int32_t *out, const int32_t *lhs, int32_t rhs, int32_t n);
+void vcalcrt_vector_nequal_int(int32_t *out, const int32_t *lhs, int32_t rhs, int32_t n);
+
+// Int op vector kernels
+void vcalcrt_int_add_vector(int32_t *out, int32_t lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_int_sub_vector(int32_t *out, int32_t lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_int_mul_vector(int32_t *out, int32_t lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_int_div_vector(int32_t *out, int32_t lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_int_less_than_vector(int32_t *out, int32_t lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_int_greater_than_vector(int32_t *out, int32_t lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_int_equal_vector(int32_t *out, int32_t lhs, const int32_t *rhs, int32_t n);
+void vcalcrt_int_nequal_vector(int32_t *out, int32_t lhs, const int32_t *rhs, int32_t n);
+
+// Fills out with value
+void vcalcrt_vector_broadcast(int32_t *out, int32_t value, int32_t n);
+
+// Fills out with lower_bound, lower_bound + 1, ...
+void vcalcrt_vector_range(int32_t *out, int32_t lower_bound, int32_t n);
+
+// Buffered output. Formats exactly like printf("%d\n") and print_vector ("[1 2 3]\n", "[]\n") but appends to one
+// process wide buffer that is written to stdout when full, at exit and on fatal signals.
+void vcalcrt_print_int(int32_t value);
+void vcalcrt_print_vector(const int32_t *data, int32_t n);
+
+// Writes out everything buffered so far
+void vcalcrt_flush(void);
+
+// Outlined loop of a generator over the domain indices [begin, end), env holds the values the body reads
+typedef void (*vcalcrt_generator_fn)(void *env, int32_t begin, int32_t end);
+
+// Outlined loop of a filter over the domain indices [begin, end), writes the kept elements in order to the start
+// of out and returns how many it kept
+typedef int32_t (*vcalcrt_filter_fn)(void *env, int32_t begin, int32_t end, int32_t *out);
+
+// Runs generator over [0, n) split into chunks on a thread pool. The pool has VCALC_NUM_THREADS threads, or one
+// per online CPU, unless vcalcrt_set_num_threads was called first. Small n and loops nested in a parallel loop
+// run on the calling thread.
+void vcalcrt_parallel_generator(vcalcrt_generator_fn generator, void *env, int32_t n);
+
+// Runs filter over [0, n) split into chunks on the thread pool into a scratch buffer, then every chunk copies its
+// kept elements to its prefix sum offset in out on the pool as well, so out holds them in domain order. Returns
+// the number of kept elements.
+int32_t vcalcrt_parallel_filter(vcalcrt_filter_fn filter, void *env, int32_t *out, int32_t n);
+
+// Overrides VCALC_NUM_THREADS, takes effect if called before the first parallel loop. Values below 1 are ignored.
+void vcalcrt_set_num_threads(int32_t threads);
+
+// Number of threads parallel loops use, including the calling thread
+int32_t vcalcrt_num_threads(void);
+
+// Name of the instruction set the kernels were dispatched to: "scalar", "sse42", "avx2" or "avx512".
+// The choice is made once at load time from CPUID and can be capped with the VCALCRT_ISA environment variable.
+const char *vcalcrt_isa(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
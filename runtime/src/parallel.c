@@ -0,0 +1,198 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "vcalcrt.h"
+
+// A pool of worker threads that runs the outlined loop of a generator or filter over chunks of its domain. The
+// calling thread works on chunks too and returns once every chunk is done. The workers are started on the first
+// parallel loop and then sleep on a condition variable between loops.
+
+// Domains smaller than this run on the calling thread, the handoff would cost more than it saves
+#define MIN_CHUNK 4096
+
+// Chunks per thread so uneven bodies (eg nested generators) still balance
+#define CHUNKS_PER_THREAD 4
+
+#define MAX_THREADS 256
+
+struct job {
+  vcalcrt_generator_fn generator;
+  vcalcrt_filter_fn filter;
+  void *env;
+  int32_t *out;
+  int32_t n;
+  int32_t chunk;
+  int32_t num_chunks;
+  atomic_int next_chunk;
+  // elements kept by each chunk of a filter, then the offset of each chunk's elements in the result
+  int32_t *counts;
+  // set for the second job of a filter, which copies each chunk's kept elements from here to its offset in out
+  int32_t *kept;
+};
+
+static int32_t num_threads = 0;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t work_done = PTHREAD_COND_INITIALIZER;
+static pthread_t workers[MAX_THREADS];
+static int32_t workers_started = 0;
+
+// Current job, a new generation wakes the workers up
+static struct job *current_job = NULL;
+static unsigned long job_generation = 0;
+static int32_t workers_pending = 0;
+
+// Set while a thread is running chunks, a generator nested in a parallel body runs sequentially
+static _Thread_local int in_parallel_loop = 0;
+
+void vcalcrt_set_num_threads(int32_t threads) {
+  if (threads > 0) {
+    num_threads = threads < MAX_THREADS ? threads : MAX_THREADS;
+  }
+}
+
+int32_t vcalcrt_num_threads(void) {
+  if (num_threads == 0) {
+    const char *env_threads = getenv("VCALC_NUM_THREADS");
+    long threads = env_threads ? strtol(env_threads, NULL, 10) : sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : (int32_t)threads;
+  }
+  return num_threads;
+}
+
+static void run_chunks(struct job *job) {
+  in_parallel_loop = 1;
+  int32_t chunk_index;
+  while ((chunk_index = atomic_fetch_add(&job->next_chunk, 1)) < job->num_chunks) {
+    int32_t begin = chunk_index * job->chunk;
+    int32_t end = job->n - begin < job->chunk ? job->n : begin + job->chunk;
+    if (job->generator) {
+      job->generator(job->env, begin, end);
+    } else if (job->kept) {
+      int32_t offset = job->counts[chunk_index];
+      memcpy(job->out + offset, job->kept + begin, (size_t)(job->counts[chunk_index + 1] - offset) * sizeof(int32_t));
+    } else {
+      // each chunk compacts what it keeps to the start of its own part of the buffer
+      job->counts[chunk_index] = job->filter(job->env, begin, end, job->out + begin);
+    }
+  }
+  in_parallel_loop = 0;
+}
+
+// start_generation is the generation when the worker was created, it only runs the jobs published after that
+static void *worker_main(void *start_generation) {
+  unsigned long seen_generation = (unsigned long)(uintptr_t)start_generation;
+  for (;;) {
+    pthread_mutex_lock(&pool_lock);
+    while (job_generation == seen_generation) {
+      pthread_cond_wait(&work_ready, &pool_lock);
+    }
+    seen_generation = job_generation;
+    struct job *job = current_job;
+    pthread_mutex_unlock(&pool_lock);
+
+    run_chunks(job);
+
+    pthread_mutex_lock(&pool_lock);
+    if (--workers_pending == 0) {
+      pthread_cond_signal(&work_done);
+    }
+    pthread_mutex_unlock(&pool_lock);
+  }
+  return NULL;
+}
+
+// Returns true when n should be split over the pool, starting the workers the first time
+static int use_pool(int32_t n) {
+  if (in_parallel_loop || n < 2 * MIN_CHUNK || vcalcrt_num_threads() < 2) {
+    return 0;
+  }
+  // no job is in flight here, so a worker added after earlier jobs (a retried pthread_create or more threads) waits
+  // for the next one instead of waking up to the finished current_job
+  pthread_mutex_lock(&pool_lock);
+  void *start_generation = (void *)(uintptr_t)job_generation;
+  pthread_mutex_unlock(&pool_lock);
+  while (workers_started < num_threads - 1) {
+    if (pthread_create(&workers[workers_started], NULL, worker_main, start_generation)) {
+      break;
+    }
+    workers_started++;
+  }
+  return workers_started > 0;
+}
+
+// Runs job over the pool, it is split into chunks unless a previous job over the same domain already did
+static void run_job(struct job *job) {
+  if (job->chunk == 0) {
+    int32_t chunks = num_threads * CHUNKS_PER_THREAD;
+    job->chunk = job->n / chunks + (job->n % chunks != 0);
+    if (job->chunk < MIN_CHUNK) {
+      job->chunk = MIN_CHUNK;
+    }
+    job->num_chunks = job->n / job->chunk + (job->n % job->chunk != 0);
+  }
+  atomic_init(&job->next_chunk, 0);
+
+  pthread_mutex_lock(&pool_lock);
+  current_job = job;
+  workers_pending = workers_started;
+  job_generation++;
+  pthread_cond_broadcast(&work_ready);
+  pthread_mutex_unlock(&pool_lock);
+
+  run_chunks(job);
+
+  pthread_mutex_lock(&pool_lock);
+  while (workers_pending > 0) {
+    pthread_cond_wait(&work_done, &pool_lock);
+  }
+  current_job = NULL;
+  pthread_mutex_unlock(&pool_lock);
+}
+
+void vcalcrt_parallel_generator(vcalcrt_generator_fn generator, void *env, int32_t n) {
+  if (!use_pool(n)) {
+    generator(env, 0, n);
+    return;
+  }
+  struct job job = {.generator = generator, .env = env, .n = n};
+  run_job(&job);
+}
+
+int32_t vcalcrt_parallel_filter(vcalcrt_filter_fn filter, void *env, int32_t *out, int32_t n) {
+  if (!use_pool(n)) {
+    return filter(env, 0, n, out);
+  }
+  // the chunks filter into a scratch buffer so the compaction below never copies onto elements not yet moved
+  int32_t *scratch = malloc((size_t)n * sizeof(int32_t));
+  int32_t *counts = malloc((size_t)(num_threads * CHUNKS_PER_THREAD + 1) * sizeof(int32_t));
+  if (!scratch || !counts) {
+    free(scratch);
+    free(counts);
+    return filter(env, 0, n, out);
+  }
+  struct job job = {.filter = filter, .env = env, .out = scratch, .n = n, .counts = counts};
+  run_job(&job);
+
+  // the exclusive prefix sum of the counts is each chunk's offset in out, one add per chunk so it stays serial
+  int32_t kept = 0;
+  for (int32_t chunk_index = 0; chunk_index < job.num_chunks; chunk_index++) {
+    int32_t count = counts[chunk_index];
+    counts[chunk_index] = kept;
+    kept += count;
+  }
+  counts[job.num_chunks] = kept;
+
+  // every chunk copies its kept elements to its offset in parallel, with the same chunks as the filter job
+  struct job copy = {.out = out, .n = n, .chunk = job.chunk, .num_chunks = job.num_chunks, .counts = counts,
+                     .kept = scratch};
+  run_job(&copy);
+  free(scratch);
+  free(counts);
+  return kept;
+}
@@ -1,6 +0,0 @@
-#include <stdio.h>
-
-// Add function named dummyPrint with signature void(int) to llvm to have this linked in.
-void dummyPrint(int i) {
-  printf("I'm a function! %d\n", i);
-}
@@ -0,0 +1,138 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "vcalcrt.h"
+
+// All program output is formatted into one process wide buffer and written to stdout with write(2) when it fills
+// up, at exit, and before the process dies on a fatal signal. When stdout is a terminal every print is flushed
+// right away so interactive output appears as soon as it did with printf.
+
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+// Longest formatted element, "-2147483648" plus a separator
+#define MAX_ELEMENT_CHARS 12
+
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static size_t output_used = 0;
+static int output_is_terminal = 0;
+
+// Writes out the whole buffer, retrying on partial writes. Only uses async-signal-safe calls.
+static void write_all(const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(STDOUT_FILENO, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    data += written;
+    size -= (size_t)written;
+  }
+}
+
+void vcalcrt_flush(void) {
+  write_all(output_buffer, output_used);
+  output_used = 0;
+}
+
+// Makes room for at least size more bytes
+static inline void reserve(size_t size) {
+  if (OUTPUT_BUFFER_SIZE - output_used < size) {
+    vcalcrt_flush();
+  }
+}
+
+// Two digit lookup so the itoa below does one division per pair of digits
+static const char digit_pairs[201] = "00010203040506070809"
+                                     "10111213141516171819"
+                                     "20212223242526272829"
+                                     "30313233343536373839"
+                                     "40414243444546474849"
+                                     "50515253545556575859"
+                                     "60616263646566676869"
+                                     "70717273747576777879"
+                                     "80818283848586878889"
+                                     "90919293949596979899";
+
+// Formats value like %d at out and returns the number of chars written, out needs MAX_ELEMENT_CHARS of room
+static inline size_t format_int(char *out, int32_t value) {
+  char digits[10];
+  char *end = digits + sizeof(digits);
+  char *start = end;
+  size_t length = 0;
+  // work on the magnitude as unsigned so INT32_MIN does not overflow
+  uint32_t magnitude = (uint32_t)value;
+  if (value < 0) {
+    out[length++] = '-';
+    magnitude = 0u - magnitude;
+  }
+  while (magnitude >= 100) {
+    uint32_t pair = (magnitude % 100) * 2;
+    magnitude /= 100;
+    *--start = digit_pairs[pair + 1];
+    *--start = digit_pairs[pair];
+  }
+  if (magnitude >= 10) {
+    *--start = digit_pairs[magnitude * 2 + 1];
+    *--start = digit_pairs[magnitude * 2];
+  } else {
+    *--start = (char)('0' + magnitude);
+  }
+  memcpy(out + length, start, (size_t)(end - start));
+  return length + (size_t)(end - start);
+}
+
+void vcalcrt_print_int(int32_t value) {
+  reserve(MAX_ELEMENT_CHARS);
+  output_used += format_int(output_buffer + output_used, value);
+  output_buffer[output_used++] = '\n';
+  if (output_is_terminal) {
+    vcalcrt_flush();
+  }
+}
+
+void vcalcrt_print_vector(const int32_t *data, int32_t n) {
+  reserve(1);
+  output_buffer[output_used++] = '[';
+  for (int32_t i = 0; i < n; i++) {
+    reserve(MAX_ELEMENT_CHARS);
+    output_used += format_int(output_buffer + output_used, data[i]);
+    output_buffer[output_used++] = i + 1 == n ? ']' : ' ';
+  }
+  if (n == 0) {
+    reserve(1);
+    output_buffer[output_used++] = ']';
+  }
+  reserve(1);
+  output_buffer[output_used++] = '\n';
+  if (output_is_terminal) {
+    vcalcrt_flush();
+  }
+}
+
+// A runtime error such as a division by zero kills the program with a signal, output printed before it must
+// still come out. The handler runs once (SA_RESETHAND), flushes and re-raises with the default action.
+static void flush_on_signal(int sig) {
+  vcalcrt_flush();
+  raise(sig);
+}
+
+__attribute__((constructor)) static void vcalcrt_init_output(void) {
+  output_is_terminal = isatty(STDOUT_FILENO);
+  atexit(vcalcrt_flush);
+
+  static const int fatal_signals[] = {SIGFPE, SIGSEGV, SIGBUS, SIGILL, SIGABRT};
+  for (size_t i = 0; i < sizeof(fatal_signals) / sizeof(fatal_signals[0]); i++) {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = flush_on_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESETHAND;
+    sigaction(fatal_signals[i], &action, NULL);
+  }
+}
@@ -0,0 +1,305 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vcalcrt.h"
+
+// Every kernel is written once as a macro over the instruction set's lane width, load, store, broadcast and
+// element-wise operations, then instantiated for scalar, SSE4.2, AVX2 and AVX-512. The public entry points jump
+// through a table that is picked once at load time.
+
+#define VCALCRT_OPS(X, isa)                                                                                            \
+  X(isa, add)                                                                                                          \
+  X(isa, sub)                                                                                                          \
+  X(isa, mul)                                                                                                          \
+  X(isa, div)                                                                                                          \
+  X(isa, less_than)                                                                                                    \
+  X(isa, greater_than)                                                                                                 \
+  X(isa, equal)                                                                                                        \
+  X(isa, nequal)
+
+// Scalar element operations, also used for the tail of every SIMD loop. Arithmetic wraps like the generated code.
+#define ATTR_scalar
+typedef int32_t scalar_v;
+static inline int32_t scalar_add(int32_t lhs, int32_t rhs) { return (int32_t)((uint32_t)lhs + (uint32_t)rhs); }
+static inline int32_t scalar_sub(int32_t lhs, int32_t rhs) { return (int32_t)((uint32_t)lhs - (uint32_t)rhs); }
+static inline int32_t scalar_mul(int32_t lhs, int32_t rhs) { return (int32_t)((uint32_t)lhs * (uint32_t)rhs); }
+static inline int32_t scalar_div(int32_t lhs, int32_t rhs) { return lhs / rhs; }
+static inline int32_t scalar_less_than(int32_t lhs, int32_t rhs) { return lhs < rhs; }
+static inline int32_t scalar_greater_than(int32_t lhs, int32_t rhs) { return lhs > rhs; }
+static inline int32_t scalar_equal(int32_t lhs, int32_t rhs) { return lhs == rhs; }
+static inline int32_t scalar_nequal(int32_t lhs, int32_t rhs) { return lhs != rhs; }
+static inline int32_t scalar_load(const int32_t *ptr) { return *ptr; }
+static inline void scalar_store(int32_t *ptr, int32_t value) { *ptr = value; }
+static inline int32_t scalar_set1(int32_t value) { return value; }
+static inline int32_t scalar_iota(int32_t lower_bound) { return lower_bound; }
+#define scalar_WIDTH 1
+
+// Vector op vector, vector op int and int op vector kernels for one operation.
+#define DEFINE_OP_KERNELS(isa, op)                                                                                     \
+  static ATTR_##isa void isa##_vector_##op(int32_t *out, const int32_t *lhs, const int32_t *rhs, int32_t n) {          \
+    int32_t i = 0;                                                                                                     \
+    for (; i + isa##_WIDTH <= n; i += isa##_WIDTH)                                                                     \
+      isa##_store(out + i, isa##_##op(isa##_load(lhs + i), isa##_load(rhs + i)));                                      \
+    for (; i < n; i++)                                                                                                 \
+      out[i] = scalar_##op(lhs[i], rhs[i]);                                                                            \
+  }                                                                                                                    \
+  static ATTR_##isa void isa##_vector_##op##_int(int32_t *out, const int32_t *lhs, int32_t rhs, int32_t n) {           \
+    isa##_v rhs_v = isa##_set1(rhs);                                                                                   \
+    int32_t i = 0;                                                                                                     \
+    for (; i + isa##_WIDTH <= n; i += isa##_WIDTH)                                                                     \
+      isa##_store(out + i, isa##_##op(isa##_load(lhs + i), rhs_v));                                                    \
+    for (; i < n; i++)                                                                                                 \
+      out[i] = scalar_##op(lhs[i], rhs);                                                                               \
+  }                                                                                                                    \
+  static ATTR_##isa void isa##_int_##op##_vector(int32_t *out, int32_t lhs, const int32_t *rhs, int32_t n) {           \
+    isa##_v lhs_v = isa##_set1(lhs);                                                                                   \
+    int32_t i = 0;                                                                                                     \
+    for (; i + isa##_WIDTH <= n; i += isa##_WIDTH)                                                                     \
+      isa##_store(out + i, isa##_##op(lhs_v, isa##_load(rhs + i)));                                                    \
+    for (; i < n; i++)                                                                                                 \
+      out[i] = scalar_##op(lhs, rhs[i]);                                                                               \
+  }
+
+#define DEFINE_ISA_KERNELS(isa)                                                                                        \
+  VCALCRT_OPS(DEFINE_OP_KERNELS, isa)                                                                                  \
+  static ATTR_##isa void isa##_vector_broadcast(int32_t *out, int32_t value, int32_t n) {                              \
+    isa##_v value_v = isa##_set1(value);                                                                               \
+    int32_t i = 0;                                                                                                     \
+    for (; i + isa##_WIDTH <= n; i += isa##_WIDTH)                                                                     \
+      isa##_store(out + i, value_v);                                                                                   \
+    for (; i < n; i++)                                                                                                 \
+      out[i] = value;                                                                                                  \
+  }                                                                                                                    \
+  static ATTR_##isa void isa##_vector_range(int32_t *out, int32_t lower_bound, int32_t n) {                            \
+    isa##_v current = isa##_iota(lower_bound);                                                                         \
+    isa##_v step = isa##_set1(isa##_WIDTH);                                                                            \
+    int32_t i = 0;                                                                                                     \
+    for (; i + isa##_WIDTH <= n; i += isa##_WIDTH) {                                                                   \
+      isa##_store(out + i, current);                                                                                   \
+      current = isa##_add(current, step);                                                                              \
+    }                                                                                                                  \
+    for (; i < n; i++)                                                                                                 \
+      out[i] = scalar_add(lower_bound, i);                                                                             \
+  }                                                                                                                    \
+  static const struct kernel_table isa##_kernels = {                                                                   \
+    VCALCRT_OPS(KERNEL_TABLE_ENTRY, isa)                                                                               \
+    .vector_broadcast = isa##_vector_broadcast,                                                                        \
+    .vector_range = isa##_vector_range,                                                                                \
+    .name = #isa,                                                                                                      \
+  };
+
+#define KERNEL_TABLE_FIELDS(isa, op)                                                                                   \
+  void (*vector_##op)(int32_t *, const int32_t *, const int32_t *, int32_t);                                           \
+  void (*vector_##op##_int)(int32_t *, const int32_t *, int32_t, int32_t);                                             \
+  void (*int_##op##_vector)(int32_t *, int32_t, const int32_t *, int32_t);
+
+#define KERNEL_TABLE_ENTRY(isa, op)                                                                                    \
+  .vector_##op = isa##_vector_##op,                                                                                    \
+  .vector_##op##_int = isa##_vector_##op##_int,                                                                        \
+  .int_##op##_vector = isa##_int_##op##_vector,
+
+struct kernel_table {
+  VCALCRT_OPS(KERNEL_TABLE_FIELDS, _)
+  void (*vector_broadcast)(int32_t *, int32_t, int32_t);
+  void (*vector_range)(int32_t *, int32_t, int32_t);
+  const char *name;
+};
+
+DEFINE_ISA_KERNELS(scalar)
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// Integer division is done through doubles, which is exact for every int32 quotient. A block that contains a zero
+// divisor or INT32_MIN / -1 is divided with scalar instructions instead, so it traps exactly like the scalar code.
+#define DEFINE_DIV(isa)                                                                                                \
+  static inline ATTR_##isa isa##_v isa##_div(isa##_v lhs, isa##_v rhs) {                                               \
+    if (isa##_needs_scalar_div(lhs, rhs)) {                                                                            \
+      int32_t lhs_a[isa##_WIDTH], rhs_a[isa##_WIDTH], out_a[isa##_WIDTH];                                              \
+      isa##_store(lhs_a, lhs);                                                                                         \
+      isa##_store(rhs_a, rhs);                                                                                         \
+      for (int i = 0; i < isa##_WIDTH; i++)                                                                            \
+        out_a[i] = scalar_div(lhs_a[i], rhs_a[i]);                                                                     \
+      return isa##_load(out_a);                                                                                        \
+    }                                                                                                                  \
+    return isa##_div_exact(lhs, rhs);                                                                                  \
+  }
+
+// SSE4.2
+#define ATTR_sse42 __attribute__((target("sse4.2")))
+#define sse42_WIDTH 4
+typedef __m128i sse42_v;
+static inline ATTR_sse42 __m128i sse42_load(const int32_t *ptr) { return _mm_loadu_si128((const __m128i *)ptr); }
+static inline ATTR_sse42 void sse42_store(int32_t *ptr, __m128i value) { _mm_storeu_si128((__m128i *)ptr, value); }
+static inline ATTR_sse42 __m128i sse42_set1(int32_t value) { return _mm_set1_epi32(value); }
+static inline ATTR_sse42 __m128i sse42_iota(int32_t lower_bound) {
+  return _mm_add_epi32(_mm_set1_epi32(lower_bound), _mm_setr_epi32(0, 1, 2, 3));
+}
+static inline ATTR_sse42 __m128i sse42_add(__m128i lhs, __m128i rhs) { return _mm_add_epi32(lhs, rhs); }
+static inline ATTR_sse42 __m128i sse42_sub(__m128i lhs, __m128i rhs) { return _mm_sub_epi32(lhs, rhs); }
+static inline ATTR_sse42 __m128i sse42_mul(__m128i lhs, __m128i rhs) { return _mm_mullo_epi32(lhs, rhs); }
+// Comparisons give all ones per true lane, shift that down to 1.
+static inline ATTR_sse42 __m128i sse42_less_than(__m128i lhs, __m128i rhs) {
+  return _mm_srli_epi32(_mm_cmplt_epi32(lhs, rhs), 31);
+}
+static inline ATTR_sse42 __m128i sse42_greater_than(__m128i lhs, __m128i rhs) {
+  return _mm_srli_epi32(_mm_cmpgt_epi32(lhs, rhs), 31);
+}
+static inline ATTR_sse42 __m128i sse42_equal(__m128i lhs, __m128i rhs) {
+  return _mm_srli_epi32(_mm_cmpeq_epi32(lhs, rhs), 31);
+}
+static inline ATTR_sse42 __m128i sse42_nequal(__m128i lhs, __m128i rhs) {
+  return _mm_add_epi32(_mm_cmpeq_epi32(lhs, rhs), _mm_set1_epi32(1));
+}
+static inline ATTR_sse42 int sse42_needs_scalar_div(__m128i lhs, __m128i rhs) {
+  __m128i zero = _mm_cmpeq_epi32(rhs, _mm_setzero_si128());
+  __m128i overflow = _mm_and_si128(_mm_cmpeq_epi32(lhs, _mm_set1_epi32(INT32_MIN)), _mm_cmpeq_epi32(rhs, _mm_set1_epi32(-1)));
+  return _mm_movemask_epi8(_mm_or_si128(zero, overflow));
+}
+static inline ATTR_sse42 __m128i sse42_div_exact(__m128i lhs, __m128i rhs) {
+  __m128i low = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(lhs), _mm_cvtepi32_pd(rhs)));
+  __m128i high = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(lhs, 0xEE)),
+                                             _mm_cvtepi32_pd(_mm_shuffle_epi32(rhs, 0xEE))));
+  return _mm_unpacklo_epi64(low, high);
+}
+DEFINE_DIV(sse42)
+DEFINE_ISA_KERNELS(sse42)
+
+// AVX2
+#define ATTR_avx2 __attribute__((target("avx2")))
+#define avx2_WIDTH 8
+typedef __m256i avx2_v;
+static inline ATTR_avx2 __m256i avx2_load(const int32_t *ptr) { return _mm256_loadu_si256((const __m256i *)ptr); }
+static inline ATTR_avx2 void avx2_store(int32_t *ptr, __m256i value) { _mm256_storeu_si256((__m256i *)ptr, value); }
+static inline ATTR_avx2 __m256i avx2_set1(int32_t value) { return _mm256_set1_epi32(value); }
+static inline ATTR_avx2 __m256i avx2_iota(int32_t lower_bound) {
+  return _mm256_add_epi32(_mm256_set1_epi32(lower_bound), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+static inline ATTR_avx2 __m256i avx2_add(__m256i lhs, __m256i rhs) { return _mm256_add_epi32(lhs, rhs); }
+static inline ATTR_avx2 __m256i avx2_sub(__m256i lhs, __m256i rhs) { return _mm256_sub_epi32(lhs, rhs); }
+static inline ATTR_avx2 __m256i avx2_mul(__m256i lhs, __m256i rhs) { return _mm256_mullo_epi32(lhs, rhs); }
+static inline ATTR_avx2 __m256i avx2_less_than(__m256i lhs, __m256i rhs) {
+  return _mm256_srli_epi32(_mm256_cmpgt_epi32(rhs, lhs), 31);
+}
+static inline ATTR_avx2 __m256i avx2_greater_than(__m256i lhs, __m256i rhs) {
+  return _mm256_srli_epi32(_mm256_cmpgt_epi32(lhs, rhs), 31);
+}
+static inline ATTR_avx2 __m256i avx2_equal(__m256i lhs, __m256i rhs) {
+  return _mm256_srli_epi32(_mm256_cmpeq_epi32(lhs, rhs), 31);
+}
+static inline ATTR_avx2 __m256i avx2_nequal(__m256i lhs, __m256i rhs) {
+  return _mm256_add_epi32(_mm256_cmpeq_epi32(lhs, rhs), _mm256_set1_epi32(1));
+}
+static inline ATTR_avx2 int avx2_needs_scalar_div(__m256i lhs, __m256i rhs) {
+  __m256i zero = _mm256_cmpeq_epi32(rhs, _mm256_setzero_si256());
+  __m256i overflow = _mm256_and_si256(_mm256_cmpeq_epi32(lhs, _mm256_set1_epi32(INT32_MIN)),
+                                      _mm256_cmpeq_epi32(rhs, _mm256_set1_epi32(-1)));
+  return _mm256_movemask_epi8(_mm256_or_si256(zero, overflow));
+}
+static inline ATTR_avx2 __m256i avx2_div_exact(__m256i lhs, __m256i rhs) {
+  __m128i low = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(lhs)),
+                                                  _mm256_cvtepi32_pd(_mm256_castsi256_si128(rhs))));
+  __m128i high = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(lhs, 1)),
+                                                   _mm256_cvtepi32_pd(_mm256_extracti128_si256(rhs, 1))));
+  return _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+}
+DEFINE_DIV(avx2)
+DEFINE_ISA_KERNELS(avx2)
+
+// AVX-512, comparisons produce a lane mask that selects 1 or 0 directly.
+#define ATTR_avx512 __attribute__((target("avx512f")))
+#define avx512_WIDTH 16
+typedef __m512i avx512_v;
+static inline ATTR_avx512 __m512i avx512_load(const int32_t *ptr) { return _mm512_loadu_si512(ptr); }
+static inline ATTR_avx512 void avx512_store(int32_t *ptr, __m512i value) { _mm512_storeu_si512(ptr, value); }
+static inline ATTR_avx512 __m512i avx512_set1(int32_t value) { return _mm512_set1_epi32(value); }
+static inline ATTR_avx512 __m512i avx512_iota(int32_t lower_bound) {
+  return _mm512_add_epi32(_mm512_set1_epi32(lower_bound),
+                          _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+}
+static inline ATTR_avx512 __m512i avx512_add(__m512i lhs, __m512i rhs) { return _mm512_add_epi32(lhs, rhs); }
+static inline ATTR_avx512 __m512i avx512_sub(__m512i lhs, __m512i rhs) { return _mm512_sub_epi32(lhs, rhs); }
+static inline ATTR_avx512 __m512i avx512_mul(__m512i lhs, __m512i rhs) { return _mm512_mullo_epi32(lhs, rhs); }
+static inline ATTR_avx512 __m512i avx512_less_than(__m512i lhs, __m512i rhs) {
+  return _mm512_maskz_set1_epi32(_mm512_cmplt_epi32_mask(lhs, rhs), 1);
+}
+static inline ATTR_avx512 __m512i avx512_greater_than(__m512i lhs, __m512i rhs) {
+  return _mm512_maskz_set1_epi32(_mm512_cmpgt_epi32_mask(lhs, rhs), 1);
+}
+static inline ATTR_avx512 __m512i avx512_equal(__m512i lhs, __m512i rhs) {
+  return _mm512_maskz_set1_epi32(_mm512_cmpeq_epi32_mask(lhs, rhs), 1);
+}
+static inline ATTR_avx512 __m512i avx512_nequal(__m512i lhs, __m512i rhs) {
+  return _mm512_maskz_set1_epi32(_mm512_cmpneq_epi32_mask(lhs, rhs), 1);
+}
+static inline ATTR_avx512 int avx512_needs_scalar_div(__m512i lhs, __m512i rhs) {
+  __mmask16 zero = _mm512_cmpeq_epi32_mask(rhs, _mm512_setzero_si512());
+  __mmask16 overflow = _mm512_cmpeq_epi32_mask(lhs, _mm512_set1_epi32(INT32_MIN)) &
+                       _mm512_cmpeq_epi32_mask(rhs, _mm512_set1_epi32(-1));
+  return zero | overflow;
+}
+static inline ATTR_avx512 __m512i avx512_div_exact(__m512i lhs, __m512i rhs) {
+  __m256i low = _mm512_cvttpd_epi32(_mm512_div_pd(_mm512_cvtepi32_pd(_mm512_castsi512_si256(lhs)),
+                                                  _mm512_cvtepi32_pd(_mm512_castsi512_si256(rhs))));
+  __m256i high = _mm512_cvttpd_epi32(_mm512_div_pd(_mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(lhs, 1)),
+                                                   _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(rhs, 1))));
+  return _mm512_inserti64x4(_mm512_castsi256_si512(low), high, 1);
+}
+DEFINE_DIV(avx512)
+DEFINE_ISA_KERNELS(avx512)
+#endif
+
+// Kernels in use, valid before the constructor below has run.
+static const struct kernel_table *active_kernels = &scalar_kernels;
+
+// Pick the widest instruction set this CPU supports. VCALCRT_ISA caps the choice, mainly for testing.
+__attribute__((constructor)) static void vcalcrt_select_isa(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  static const struct kernel_table *const by_width[] = {&scalar_kernels, &sse42_kernels, &avx2_kernels,
+                                                        &avx512_kernels};
+  int max_level = 3;
+  const char *cap = getenv("VCALCRT_ISA");
+  if (cap) {
+    for (int level = 0; level < 4; level++) {
+      if (!strcmp(cap, by_width[level]->name)) {
+        max_level = level;
+      }
+    }
+  }
+
+  __builtin_cpu_init();
+  int level = 0;
+  if (__builtin_cpu_supports("sse4.2")) {
+    level = 1;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    level = 2;
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    level = 3;
+  }
+  active_kernels = by_width[level < max_level ? level : max_level];
+#endif
+}
+
+#define DEFINE_ENTRY_POINTS(isa, op)                                                                                   \
+  void vcalcrt_vector_##op(int32_t *out, const int32_t *lhs, const int32_t *rhs, int32_t n) {                          \
+    active_kernels->vector_##op(out, lhs, rhs, n);                                                                     \
+  }                                                                                                                    \
+  void vcalcrt_vector_##op##_int(int32_t *out, const int32_t *lhs, int32_t rhs, int32_t n) {                           \
+    active_kernels->vector_##op##_int(out, lhs, rhs, n);                                                               \
+  }                                                                                                                    \
+  void vcalcrt_int_##op##_vector(int32_t *out, int32_t lhs, const int32_t *rhs, int32_t n) {                           \
+    active_kernels->int_##op##_vector(out, lhs, rhs, n);                                                               \
+  }
+
+VCALCRT_OPS(DEFINE_ENTRY_POINTS, _)
+
+void vcalcrt_vector_broadcast(int32_t *out, int32_t value, int32_t n) { active_kernels->vector_broadcast(out, value, n); }
+
+void vcalcrt_vector_range(int32_t *out, int32_t lower_bound, int32_t n) {
+  active_kernels->vector_range(out, lower_bound, n);
+}
+
+const char *vcalcrt_isa(void) { return active_kernels->name; }
@@ -1,50 +1,126 @@
 #include "Ast.h"
 namespace Ast{
 
-AstNode::AstNode(size_t token_type) : token(std::make_shared<antlr4::CommonToken>(token_type)) {}
+AstArena::AstArena(){
+    // index 0 of the side tables is "none" so a zeroed record references nothing
+    texts.emplace_back();
+    text_ids.emplace(texts.back(), 0);
+    references.push_back(nullptr);
+    reference_ids.emplace(nullptr, 0);
+    scopes.push_back(nullptr);
+    scope_ids.emplace(nullptr, 0);
+}
+
+uint32_t AstArena::Intern(std::string_view text){
+    auto found = text_ids.find(text);
+    if (found != text_ids.end()){
+        return found->second;
+    }
+    uint32_t text_id = texts.size();
+    texts.emplace_back(text);
+    text_ids.emplace(texts.back(), text_id);
+    return text_id;
+}
+
+uint32_t AstArena::AppendChildren(const Node *first, size_t count){
+    uint32_t first_child = children.size();
+    for (size_t i = 0; i < count; i++){
+        children.push_back(first[i].GetId());
+    }
+    return first_child;
+}
+
+Node AstArena::NewLeaf(size_t type, std::string_view text, size_t line, size_t column){
+    nodes.push_back(AstNode{static_cast<uint32_t>(type), Intern(text), static_cast<uint32_t>(line),
+                            static_cast<uint32_t>(column)});
+    return Node(this, nodes.size() - 1);
+}
+
+Node AstArena::NewNode(size_t type, std::initializer_list<Node> node_children){
+    AstNode record{static_cast<uint32_t>(type), 0, 0, 0};
+    record.first_child = AppendChildren(node_children.begin(), node_children.size());
+    record.child_count = node_children.size();
+    nodes.push_back(record);
+    return Node(this, nodes.size() - 1);
+}
 
-AstNode::AstNode(antlr4::Token* init_token) : token(std::make_shared<antlr4::CommonToken>(init_token)) {}
+Node AstArena::NewNode(size_t type, const std::vector<Node> &node_children){
+    AstNode record{static_cast<uint32_t>(type), 0, 0, 0};
+    record.first_child = AppendChildren(node_children.data(), node_children.size());
+    record.child_count = node_children.size();
+    nodes.push_back(record);
+    return Node(this, nodes.size() - 1);
+}
 
-std::vector<std::shared_ptr<AstNode>> AstNode::GetChildren(){
-    return children;
+void Node::SetChildren(std::initializer_list<Node> new_children) const{
+    uint32_t first_child = arena->AppendChildren(new_children.begin(), new_children.size());
+    Record().first_child = first_child;
+    Record().child_count = new_children.size();
 }
 
-void AstNode::AddChild(std::any child){
-    AddChild(std::any_cast<std::shared_ptr<AstNode>>(child));
+void Node::SetChildren(NodeSpan new_children) const{
+    uint32_t first_child = arena->children.size();
+    for (size_t i = 0; i < new_children.size(); i++){
+        arena->children.push_back(new_children[i].GetId());
+    }
+    Record().first_child = first_child;
+    Record().child_count = new_children.size();
 }
 
-void AstNode::AddChild(std::shared_ptr<AstNode> child){
-    children.push_back(child);
+const std::string &Node::GetText() const{
+    return arena->texts[Record().text];
 }
 
-size_t AstNode::GetNodeType(){
-    return token->getType();
+uint32_t Node::GetTextId() const{
+    return Record().text;
 }
 
-std::string AstNode::GetText(){
-    return token->getText();
+size_t Node::GetLine() const{
+    return Record().line;
 }
 
-std::shared_ptr<Symbol::BaseSymbol> AstNode::GetReference(){
-    return reference;
+size_t Node::GetColumn() const{
+    return Record().column;
 }
 
-void AstNode::SetReference(std::shared_ptr<Symbol::BaseSymbol> new_reference){
-    reference = new_reference;
+const std::shared_ptr<Symbol::BaseSymbol> &Node::GetReference() const{
+    return arena->references[Record().reference];
 }
 
-void AstNode::SetScope(std::shared_ptr<Scope::BaseScope> new_scope){
-    scope = new_scope;
+void Node::SetReference(std::shared_ptr<Symbol::BaseSymbol> new_reference) const{
+    auto inserted = arena->reference_ids.emplace(new_reference.get(), arena->references.size());
+    if (inserted.second){
+        arena->references.push_back(std::move(new_reference));
+    }
+    Record().reference = inserted.first->second;
 }
-std::shared_ptr<Scope::BaseScope> AstNode::GetScope(){
-    return scope;
+
+const std::shared_ptr<Scope::BaseScope> &Node::GetScope() const{
+    return arena->scopes[Record().scope];
 }
-std::shared_ptr<antlr4::Token> AstNode::GetToken() {
-    return token;
+
+void Node::SetScope(std::shared_ptr<Scope::BaseScope> new_scope) const{
+    auto inserted = arena->scope_ids.emplace(new_scope.get(), arena->scopes.size());
+    if (inserted.second){
+        arena->scopes.push_back(std::move(new_scope));
+    }
+    Record().scope = inserted.first->second;
+}
+
+int32_t Node::GetLength() const{
+    return Record().length;
+}
+
+void Node::SetLength(int32_t new_length) const{
+    Record().length = new_length;
+}
+
+uint32_t Node::GetLengthClass() const{
+    return Record().length_class;
 }
 
-size_t AstNode::GetLine() {
-    return token->getLine();
+void Node::SetLengthClass(uint32_t new_length_class) const{
+    Record().length_class = new_length_class;
 }
 
 }
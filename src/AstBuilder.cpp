@@ -2,82 +2,79 @@
 
 namespace AstBuilder{
 
+Ast::Node AstBuild::VisitNode(antlr4::tree::ParseTree *tree){
+    return Ast::Node(&arena, std::any_cast<Ast::NodeId>(visit(tree)));
+}
+
+Ast::Node AstBuild::TokenNode(antlr4::tree::TerminalNode *terminal){
+    antlr4::Token *token = terminal->getSymbol();
+    return arena.NewLeaf(token->getType(), token->getText(), token->getLine(), token->getCharPositionInLine());
+}
+
 std::any AstBuild::visitFile(vcalc::VCalcParser::FileContext *ctx){
     return visit(ctx->block());
 }
 
-std::any AstBuild::AddOperationNode(vcalc::VCalcParser::ExprContext *ctx){
-    std::shared_ptr<Ast::AstNode> operation_node;
+Ast::Node AstBuild::AddOperationNode(vcalc::VCalcParser::ExprContext *ctx){
     if (ctx->ADD() != nullptr){
-        operation_node = std::make_shared<Ast::AstNode>(ctx->ADD()->getSymbol());
+        return TokenNode(ctx->ADD());
     }
     else if (ctx->SUB() != nullptr){
-        operation_node = std::make_shared<Ast::AstNode>(ctx->SUB()->getSymbol());
+        return TokenNode(ctx->SUB());
     }
     else if (ctx->MUL() != nullptr){
-        operation_node = std::make_shared<Ast::AstNode>(ctx->MUL()->getSymbol());
+        return TokenNode(ctx->MUL());
     }
     else if (ctx->DIV() != nullptr){
-        operation_node = std::make_shared<Ast::AstNode>(ctx->DIV()->getSymbol());
+        return TokenNode(ctx->DIV());
     }
     else if (ctx->LESS() != nullptr){
-        operation_node = std::make_shared<Ast::AstNode>(ctx->LESS()->getSymbol());
+        return TokenNode(ctx->LESS());
     }
     else if (ctx->GREATER() != nullptr){
-        operation_node = std::make_shared<Ast::AstNode>(ctx->GREATER()->getSymbol());
+        return TokenNode(ctx->GREATER());
     }
     else if (ctx->LOGEQ() != nullptr){
-        operation_node = std::make_shared<Ast::AstNode>(ctx->LOGEQ()->getSymbol());
+        return TokenNode(ctx->LOGEQ());
     }
     else if (ctx->LOGNEQ() != nullptr){
-        operation_node = std::make_shared<Ast::AstNode>(ctx->LOGNEQ()->getSymbol());
+        return TokenNode(ctx->LOGNEQ());
     }
     else if (ctx->DOTS() != nullptr){
-        operation_node = std::make_shared<Ast::AstNode>(ctx->DOTS()->getSymbol());
+        return TokenNode(ctx->DOTS());
     }
-    else{ // an index operation
-        operation_node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::INDEX);
-    }
-    return operation_node;
+    // an index operation
+    return arena.NewNode(vcalc::VCalcParser::INDEX);
 }
 
+// children are made before their parent so a node's child list is appended to the arena in one piece
 std::any AstBuild::visitExpr(vcalc::VCalcParser::ExprContext *ctx){
-    std::shared_ptr<Ast::AstNode> node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::EXPR);
-    std::shared_ptr<Ast::AstNode> token_node;
-    std::shared_ptr<Ast::AstNode> id_node;
+    Ast::Node node;
     if (ctx->ID() != nullptr){ // leaf expr node with child ID token
-        token_node = std::make_shared<Ast::AstNode>(ctx->ID()->getSymbol());
-        node->AddChild(token_node);
+        node = arena.NewNode(vcalc::VCalcParser::EXPR, {TokenNode(ctx->ID())});
     }
     else if (ctx->INT() != nullptr){ // leaf expr node with child INT token
-        token_node = std::make_shared<Ast::AstNode>(ctx->INT()->getSymbol());
-        node->AddChild(token_node);
+        node = arena.NewNode(vcalc::VCalcParser::EXPR, {TokenNode(ctx->INT())});
     }
     else if (ctx->generator() != nullptr){ // just a single generator child
-        node->AddChild(visit(ctx->generator()->expr(0)));
-        token_node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::GENERATOR);
-        id_node = std::make_shared<Ast::AstNode>(ctx->generator()->ID()->getSymbol());
-        token_node->AddChild(id_node);
-        node->AddChild(token_node);
-        node->AddChild(visit(ctx->generator()->expr(1)));
+        Ast::Node domain = VisitNode(ctx->generator()->expr(0));
+        Ast::Node generator = arena.NewNode(vcalc::VCalcParser::GENERATOR, {TokenNode(ctx->generator()->ID())});
+        node = arena.NewNode(vcalc::VCalcParser::EXPR, {domain, generator, VisitNode(ctx->generator()->expr(1))});
     }
     else if (ctx->filter() != nullptr){ // just a single filter child
-        node->AddChild(visit(ctx->filter()->expr(0)));
-        token_node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::FILTER);
-        id_node = std::make_shared<Ast::AstNode>(ctx->filter()->ID()->getSymbol());
-        token_node->AddChild(id_node);
-        node->AddChild(token_node);
-        node->AddChild(visit(ctx->filter()->expr(1)));
+        Ast::Node domain = VisitNode(ctx->filter()->expr(0));
+        Ast::Node filter = arena.NewNode(vcalc::VCalcParser::FILTER, {TokenNode(ctx->filter()->ID())});
+        node = arena.NewNode(vcalc::VCalcParser::EXPR, {domain, filter, VisitNode(ctx->filter()->expr(1))});
     }
     else if (ctx->expr(1) == nullptr){ // parenthesis expr node
         return visit(ctx->expr(0));
     }
     else{ // other cases with 2 expr nodes and middle token
-        node->AddChild(visit(ctx->expr(0)));
-        node->AddChild(AddOperationNode(ctx)); // have to check each of the possible operation tokens manually sadly 
-        node->AddChild(visit(ctx->expr(1)));
+        Ast::Node left = VisitNode(ctx->expr(0));
+        Ast::Node operation = AddOperationNode(ctx); // have to check each of the possible operation tokens manually sadly 
+        node = arena.NewNode(vcalc::VCalcParser::EXPR, {left, operation, VisitNode(ctx->expr(1))});
     }
-    return node;
+    return node.GetId();
 }
 
 std::any AstBuild::visitStatement(vcalc::VCalcParser::StatementContext *ctx){
@@ -85,58 +82,44 @@ std::any AstBuild::visitStatement(vcalc::VCalcParser::StatementContext *ctx){
 }
 
 std::any AstBuild::visitBlock(vcalc::VCalcParser::BlockContext *ctx){
-    std::shared_ptr<Ast::AstNode> node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::BLOCK);
+    std::vector<Ast::Node> statements;
     for (auto *child : ctx->children){
-        node->AddChild(visit(child));
+        statements.push_back(VisitNode(child));
     }
-    return node;
+    return arena.NewNode(vcalc::VCalcParser::BLOCK, statements).GetId();
 }
-std::any AstBuild::AddAssignNode(vcalc::VCalcParser::DeclarationContext *ctx){
-    std::shared_ptr<Ast::AstNode> node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::ASSIGN);
-    std::shared_ptr<Ast::AstNode> id_node = std::make_shared<Ast::AstNode>(ctx->ID()->getSymbol());
-    node->AddChild(id_node);
-    node->AddChild(visit(ctx->expr()));
-    return node;
+
+Ast::Node AstBuild::AddAssignNode(vcalc::VCalcParser::DeclarationContext *ctx){
+    Ast::Node id_node = TokenNode(ctx->ID());
+    return arena.NewNode(vcalc::VCalcParser::ASSIGN, {id_node, VisitNode(ctx->expr())});
 }
 
 std::any AstBuild::visitDeclaration(vcalc::VCalcParser::DeclarationContext *ctx){
-    std::shared_ptr<Ast::AstNode> node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::DECL);
-    std::shared_ptr<Ast::AstNode> type_node = std::make_shared<Ast::AstNode>(ctx->TYPE()->getSymbol());
-    std::shared_ptr<Ast::AstNode> id_node = std::make_shared<Ast::AstNode>(ctx->ID()->getSymbol());
-    node->AddChild(type_node);
-    node->AddChild(id_node);
+    Ast::Node type_node = TokenNode(ctx->TYPE());
+    Ast::Node id_node = TokenNode(ctx->ID());
     if (ctx->expr() != nullptr){
-        node->AddChild(AddAssignNode(ctx));
+        return arena.NewNode(vcalc::VCalcParser::DECL, {type_node, id_node, AddAssignNode(ctx)}).GetId();
     }
-    return node;
+    return arena.NewNode(vcalc::VCalcParser::DECL, {type_node, id_node}).GetId();
 }
 
 std::any AstBuild::visitAssignment(vcalc::VCalcParser::AssignmentContext *ctx){
-    std::shared_ptr<Ast::AstNode> node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::ASSIGN);
-    std::shared_ptr<Ast::AstNode> id_node = std::make_shared<Ast::AstNode>(ctx->ID()->getSymbol());
-    node->AddChild(id_node);
-    node->AddChild(visit(ctx->expr()));
-    return node;
+    Ast::Node id_node = TokenNode(ctx->ID());
+    return arena.NewNode(vcalc::VCalcParser::ASSIGN, {id_node, VisitNode(ctx->expr())}).GetId();
 }
 
 std::any AstBuild::visitIf_stat(vcalc::VCalcParser::If_statContext *ctx){
-    std::shared_ptr<Ast::AstNode> node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::IF_BLOCK);
-    node->AddChild(visit(ctx->expr()));
-    node->AddChild(visit(ctx->block()));
-    return node;
+    Ast::Node condition = VisitNode(ctx->expr());
+    return arena.NewNode(vcalc::VCalcParser::IF_BLOCK, {condition, VisitNode(ctx->block())}).GetId();
 }
 
 std::any AstBuild::visitLoop(vcalc::VCalcParser::LoopContext *ctx){
-    std::shared_ptr<Ast::AstNode> node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::LOOP_BLOCK);
-    node->AddChild(visit(ctx->expr()));
-    node->AddChild(visit(ctx->block()));
-    return node;
+    Ast::Node condition = VisitNode(ctx->expr());
+    return arena.NewNode(vcalc::VCalcParser::LOOP_BLOCK, {condition, VisitNode(ctx->block())}).GetId();
 }
 
 std::any AstBuild::visitPrint(vcalc::VCalcParser::PrintContext *ctx){
-    std::shared_ptr<Ast::AstNode> node = std::make_shared<Ast::AstNode>(vcalc::VCalcParser::PRINT);
-    node->AddChild(visit(ctx->expr()));
-    return node;
+    return arena.NewNode(vcalc::VCalcParser::PRINT, {VisitNode(ctx->expr())}).GetId();
 }
 
-}
\ No newline at end of file
+}
@@ -3,7 +3,7 @@
 namespace AstVisitor{
 
 // AstVisitor Base methods
-void AstWalker::Visit(std::shared_ptr<Ast::AstNode> current_node){
+void AstWalker::Visit(Ast::Node current_node){
     switch (current_node->GetNodeType() ) {
         case vcalc::VCalcParser::BLOCK:
             VisitBLOCK(current_node);
@@ -38,14 +38,14 @@ void AstWalker::Visit(std::shared_ptr<Ast::AstNode> current_node){
     return; // infinite recursion somewhere, idk where
 }
 
-void AstWalker::VisitChildren(std::shared_ptr<Ast::AstNode> current_node){
+void AstWalker::VisitChildren(Ast::Node current_node){
     for ( const auto& child : current_node->GetChildren() ){
         Visit(child);
     }
 }
 
 // DefRef Visitor methods
-void DefRef::VisitBLOCK(std::shared_ptr<Ast::AstNode> current_node) {
+void DefRef::VisitBLOCK(Ast::Node current_node) {
     if (program_flags & DEBUG){
         std::cout << "AT BLOCK\n";
     }
@@ -53,12 +53,11 @@ void DefRef::VisitBLOCK(std::shared_ptr<Ast::AstNode> current_node) {
     if (global_scope) {
         current_scope = std::make_shared<Scope::GlobalScope>(nullptr);
         current_node->SetScope(current_scope);
-        std::vector<std::shared_ptr<Symbol::BuiltInTypeSymbol>> builtInTypes = {
-                std::make_shared<Symbol::BuiltInTypeSymbol>("int",current_scope,Type::VCalcTypes::INT),
-                std::make_shared<Symbol::BuiltInTypeSymbol>("vector",current_scope,Type::VCalcTypes::VECTOR)
-        };
-        for (const std::shared_ptr<Symbol::BuiltInTypeSymbol>& builtInType : builtInTypes) {
-            current_scope->Define(builtInType);
+        // names are interned by the arena, so the TYPE tokens of declarations resolve to these ids
+        int_type_symbol = std::make_shared<Symbol::BuiltInTypeSymbol>("int",current_scope,Type::VCalcTypes::INT);
+        vector_type_symbol = std::make_shared<Symbol::BuiltInTypeSymbol>("vector",current_scope,Type::VCalcTypes::VECTOR);
+        for (const std::shared_ptr<Symbol::BuiltInTypeSymbol>& builtInType : {int_type_symbol, vector_type_symbol}) {
+            current_scope->Define(current_node->GetArena()->Intern(builtInType->GetName()), builtInType);
         }
         if (program_flags & DEBUG) {
             std::cout << "Initialized Built In Types: ";
@@ -88,7 +87,7 @@ void DefRef::VisitBLOCK(std::shared_ptr<Ast::AstNode> current_node) {
     }
 
 }
-void DefRef::VisitIF_BLOCK(std::shared_ptr<Ast::AstNode> current_node){
+void DefRef::VisitIF_BLOCK(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT IF_BLOCK\n";
     }
@@ -99,7 +98,7 @@ void DefRef::VisitIF_BLOCK(std::shared_ptr<Ast::AstNode> current_node){
         throw std::runtime_error("Type mismatch at line " + std::to_string(current_node->GetLine()) + ": expression value must be int");
     }
 }
-void DefRef::VisitLOOP_BLOCK(std::shared_ptr<Ast::AstNode> current_node){
+void DefRef::VisitLOOP_BLOCK(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT LOOP_BLOCK\n";
     }
@@ -110,15 +109,14 @@ void DefRef::VisitLOOP_BLOCK(std::shared_ptr<Ast::AstNode> current_node){
         throw std::runtime_error("Type mismatch at line " + std::to_string(current_node->GetLine()) + ": expression value must be int");
     }
 }
-void DefRef::VisitDECL(std::shared_ptr<Ast::AstNode> current_node){
+void DefRef::VisitDECL(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT DECL\n";
     }
     auto type_node = current_node->GetChildren()[0];
     auto id_node = current_node->GetChildren()[1];
-    std::cout << "here\n";
 
-    auto symbol_val = current_scope->Resolve(type_node->GetText());
+    auto symbol_val = current_scope->Resolve(type_node->GetTextId());
     if (!symbol_val) {
         throw std::runtime_error("Invalid declaration keyword " + std::to_string(current_node->GetLine()) + ": " + type_node->GetText());
     }
@@ -126,16 +124,16 @@ void DefRef::VisitDECL(std::shared_ptr<Ast::AstNode> current_node){
     if (!type_symbol) {
         throw std::runtime_error("Invalid declaration keyword " + std::to_string(current_node->GetLine()) + ": " + type_node->GetText());
     }
-    auto sym_map = current_scope->GetSymbols();
-    if (sym_map.find(id_node->GetText()) != sym_map.end()) {
+    if (current_scope->ResolveLocal(id_node->GetTextId())) {
         throw std::runtime_error("Invalid declaration twice " + std::to_string(current_node->GetLine()) + ": " + type_node->GetText());
     }
 
 
     auto var_symbol = std::make_shared<Symbol::VarSymbol>(id_node->GetText(), current_scope, type_symbol);
-    current_scope->Define(var_symbol);
+    current_scope->Define(id_node->GetTextId(), var_symbol);
     current_node->SetScope((current_scope));
     current_node->SetReference(var_symbol);
+    id_node->SetReference(var_symbol);
 
     bool assign = current_node->GetChildren().size() > 2;
     if (assign) {
@@ -147,27 +145,29 @@ void DefRef::VisitDECL(std::shared_ptr<Ast::AstNode> current_node){
     }
 
 }
-void DefRef::VisitASSIGN(std::shared_ptr<Ast::AstNode> current_node){
+void DefRef::VisitASSIGN(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT ASSIGN\n";
     }
-    std::shared_ptr<Ast::AstNode> id_node = current_node->GetChildren()[0];
-    std::shared_ptr<Ast::AstNode> expression_node = current_node->GetChildren()[1];
+    Ast::Node id_node = current_node->GetChildren()[0];
+    Ast::Node expression_node = current_node->GetChildren()[1];
 
     VisitEXPR(expression_node);
     auto expr_type = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(expression_node->GetReference());
 
-    auto symbol = current_scope->Resolve(id_node->GetText());
+    auto symbol = current_scope->Resolve(id_node->GetTextId());
     if (!symbol) {
         throw std::runtime_error("Tried to access undefined variable at line " + std::to_string(current_node->GetLine()));
     }
 
+    // later passes read the variable from the ID node instead of resolving its name again
     auto var_symbol = std::static_pointer_cast<Symbol::VarSymbol>(symbol);
+    id_node->SetReference(var_symbol);
     if (expr_type->GetType() != var_symbol->GetTypeSymbol()->GetType()) {
         throw std::runtime_error("Type mismatch at line " + std::to_string(current_node->GetLine()) + ": " + var_symbol->GetName() + " has different type than expression");
     }
 }
-void DefRef::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
+void DefRef::VisitEXPR(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT EXPR\n";
     }
@@ -176,15 +176,16 @@ void DefRef::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
         auto child = current_node->GetChildren()[0];
         switch (child->GetNodeType()) {
             case vcalc::VCalcParser::ID: { // Block is required to prevent jump bypass switch statement???
-                auto var_symbol = std::static_pointer_cast<Symbol::VarSymbol>(current_scope->Resolve(child->GetText()));
+                auto var_symbol = std::static_pointer_cast<Symbol::VarSymbol>(current_scope->Resolve(child->GetTextId()));
                 if (!var_symbol) {
                     throw std::runtime_error("Tried to access undefined variable at line " + std::to_string(child->GetLine()) + ": " + child->GetText());
                 }
+                child->SetReference(var_symbol);
                 current_node->SetReference(var_symbol->GetTypeSymbol());
                 return;
             }
             case vcalc::VCalcParser::INT:
-                current_node->SetReference(GetBuiltInTypeData("int"));
+                current_node->SetReference(int_type_symbol);
                 return;
             case vcalc::VCalcParser::EXPR:
                 VisitEXPR(child);
@@ -207,9 +208,9 @@ void DefRef::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
     }
 
     if (operation_group == Scoped) {
-        std::shared_ptr<Ast::AstNode> iterator_expression_node = current_node->GetChildren()[0];
-        std::shared_ptr<Ast::AstNode> id_node = current_node->GetChildren()[1]->GetChildren()[0];
-        std::shared_ptr<Ast::AstNode> eval_expression_node = current_node->GetChildren()[2];
+        Ast::Node iterator_expression_node = current_node->GetChildren()[0];
+        Ast::Node id_node = current_node->GetChildren()[1]->GetChildren()[0];
+        Ast::Node eval_expression_node = current_node->GetChildren()[2];
 
         VisitEXPR(iterator_expression_node);
         auto built_in_type = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(iterator_expression_node->GetReference());
@@ -219,10 +220,9 @@ void DefRef::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
         current_scope = std::make_shared<Scope::LocalScope>(current_scope);
 
         // Define new int variable
-        auto int_type = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(current_scope->Resolve("int"));
         std::string var_name = id_node->GetText();
-        std::shared_ptr<Symbol::VarSymbol> var_symbol = std::make_shared<Symbol::VarSymbol>(var_name, current_scope, int_type);
-        current_scope->Define(var_symbol);
+        std::shared_ptr<Symbol::VarSymbol> var_symbol = std::make_shared<Symbol::VarSymbol>(var_name, current_scope, int_type_symbol);
+        current_scope->Define(id_node->GetTextId(), var_symbol);
         id_node->SetReference(var_symbol);
         id_node->SetScope(current_scope);
 
@@ -237,12 +237,12 @@ void DefRef::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
         current_scope = current_scope->GetEnclosingScope();
 
         // Generator and Filter return vector types
-        current_node->SetReference(GetBuiltInTypeData("vector"));
+        current_node->SetReference(vector_type_symbol);
         return;
     }
     size_t op_type = current_node->GetChildren()[1]->GetNodeType();
-    std::shared_ptr<Ast::AstNode> left = current_node->GetChildren()[0];
-    std::shared_ptr<Ast::AstNode> right = current_node->GetChildren()[2];
+    Ast::Node left = current_node->GetChildren()[0];
+    Ast::Node right = current_node->GetChildren()[2];
 
     VisitEXPR(left);
     VisitEXPR(right);
@@ -259,14 +259,14 @@ void DefRef::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
                 return;
             }
             // Promote int to vector. Only two types so we can hard code this.
-            current_node->SetReference(GetBuiltInTypeData("vector"));
+            current_node->SetReference(vector_type_symbol);
             return;
         case Bool:
             if (left_type_val == Type::VCalcTypes::VECTOR || right_type_val == Type::VCalcTypes::VECTOR) { 
-                current_node->SetReference(GetBuiltInTypeData("vector"));
+                current_node->SetReference(vector_type_symbol);
             }
             else{
-                current_node->SetReference(GetBuiltInTypeData("int"));
+                current_node->SetReference(int_type_symbol);
             }
             return;
         default:
@@ -277,17 +277,17 @@ void DefRef::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
             if (left_type_val != Type::VCalcTypes::INT || right_type_val != Type::VCalcTypes::INT) {
                 throw std::runtime_error("Type mismatch at line " + std::to_string(current_node->GetLine()) + ": range values must be int");
             }
-            current_node->SetReference(GetBuiltInTypeData("vector"));
+            current_node->SetReference(vector_type_symbol);
             return;
         case vcalc::VCalcParser::INDEX:
             if (left_type_val != Type::VCalcTypes::VECTOR) {
                 throw std::runtime_error("Type mismatch at line " + std::to_string(current_node->GetLine()) + ": the value being indexed must be a vector");
             }
             if (right_type_val == Type::VCalcTypes::INT) {
-                current_node->SetReference(GetBuiltInTypeData("int"));
+                current_node->SetReference(int_type_symbol);
             }
             else{
-                current_node->SetReference(GetBuiltInTypeData("vector"));
+                current_node->SetReference(vector_type_symbol);
             }
             return;
         default:
@@ -295,16 +295,16 @@ void DefRef::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
     }
     std::cerr << "Did not cover case operation for: " << op_type << std::endl;
 }
-void DefRef::VisitPRINT(std::shared_ptr<Ast::AstNode> current_node){
+void DefRef::VisitPRINT(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT PRINT\n";
     }
     VisitChildren(current_node);
 }
-void DefRef::VisitID(std::shared_ptr<Ast::AstNode> current_node){
+void DefRef::VisitID(Ast::Node current_node){
 
 }
-void DefRef::VisitINT(std::shared_ptr<Ast::AstNode> current_node){
+void DefRef::VisitINT(Ast::Node current_node){
 
 }
 
@@ -332,100 +332,577 @@ DefRef::DefRef() {
     };
 }
 
-    std::shared_ptr<Symbol::BuiltInTypeSymbol> DefRef::GetBuiltInTypeData(const std::string &type) {
-        return std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(current_scope->Resolve(type));
+
+// ConstantFolder Visitor methods
+void ConstantFolder::VisitBLOCK(Ast::Node current_node){
+    VisitChildren(current_node);
+}
+void ConstantFolder::VisitIF_BLOCK(Ast::Node current_node){
+    VisitChildren(current_node);
+}
+void ConstantFolder::VisitLOOP_BLOCK(Ast::Node current_node){
+    VisitChildren(current_node);
+}
+void ConstantFolder::VisitDECL(Ast::Node current_node){
+    VisitChildren(current_node);
+}
+void ConstantFolder::VisitASSIGN(Ast::Node current_node){
+    VisitChildren(current_node);
+}
+void ConstantFolder::VisitPRINT(Ast::Node current_node){
+    VisitChildren(current_node);
+}
+void ConstantFolder::VisitID(Ast::Node current_node){
+
+}
+void ConstantFolder::VisitINT(Ast::Node current_node){
+
+}
+
+void ConstantFolder::VisitEXPR(Ast::Node current_node){
+    // fold bottom up so folded children can fold their parent
+    VisitChildren(current_node);
+    if (current_node->GetChildren().size() != 3){
+        return;
+    }
+    Ast::Node left = current_node->GetChildren()[0];
+    Ast::Node op_node = current_node->GetChildren()[1];
+    Ast::Node right = current_node->GetChildren()[2];
+    size_t op = op_node->GetNodeType();
+    if (op == vcalc::VCalcParser::GENERATOR || op == vcalc::VCalcParser::FILTER || op == vcalc::VCalcParser::DOTS){
+        return;
+    }
+
+    int32_t lhs, rhs, lower, upper, result;
+    bool left_constant = GetConstant(left, lhs);
+    bool right_constant = GetConstant(right, rhs);
+
+    if (op == vcalc::VCalcParser::INDEX){
+        if (!GetConstantRange(left, lower, upper)){
+            return;
+        }
+        int64_t last_index = (int64_t)upper - lower;
+        if (right_constant){ // out of bounds reads as 0
+            ReplaceWithConstant(current_node, (rhs >= 0 && rhs <= last_index) ? lower + rhs : 0);
+            return;
+        }
+        int32_t index_lower, index_upper;
+        if (GetConstantRange(right, index_lower, index_upper) && index_lower >= 0 && index_lower <= index_upper && index_upper <= last_index){
+            ReplaceWithRange(current_node, right->GetChildren()[1], lower + index_lower, lower + index_upper, right->GetChildren()[0]->GetReference());
+        }
+        return;
+    }
+
+    if (left_constant && right_constant){
+        if (FoldIntOperation(op, lhs, rhs, result)){
+            ReplaceWithConstant(current_node, result);
+        }
+        return;
+    }
+
+    // shifting a constant range keeps it a range, as long as neither bound wraps
+    if (op == vcalc::VCalcParser::ADD || op == vcalc::VCalcParser::SUB){
+        int64_t shift = 0;
+        bool shifted = false;
+        Ast::Node range;
+        if (right_constant && GetConstantRange(left, lower, upper)){
+            shift = op == vcalc::VCalcParser::ADD ? (int64_t)rhs : -(int64_t)rhs;
+            range = left;
+            shifted = true;
+        }
+        else if (left_constant && op == vcalc::VCalcParser::ADD && GetConstantRange(right, lower, upper)){
+            shift = lhs;
+            range = right;
+            shifted = true;
+        }
+        if (shifted && FitsInt(lower + shift) && FitsInt(upper + shift)){
+            ReplaceWithRange(current_node, range->GetChildren()[1], lower + shift, upper + shift, range->GetChildren()[0]->GetReference());
+            return;
+        }
+    }
+
+    // identities keep the other operand, which always has the type of the whole expression
+    switch (op){
+        case vcalc::VCalcParser::ADD:
+            if (right_constant && rhs == 0){
+                ReplaceWith(current_node, left);
+            }
+            else if (left_constant && lhs == 0){
+                ReplaceWith(current_node, right);
+            }
+            break;
+        case vcalc::VCalcParser::SUB:
+            if (right_constant && rhs == 0){
+                ReplaceWith(current_node, left);
+            }
+            break;
+        case vcalc::VCalcParser::MUL:
+            if (right_constant && rhs == 1){
+                ReplaceWith(current_node, left);
+            }
+            else if (left_constant && lhs == 1){
+                ReplaceWith(current_node, right);
+            }
+            break;
+        case vcalc::VCalcParser::DIV:
+            if (right_constant && rhs == 1){
+                ReplaceWith(current_node, left);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool ConstantFolder::FitsInt(int64_t value){
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+bool ConstantFolder::GetConstant(Ast::Node node, int32_t &value){
+    if (node->GetNodeType() != vcalc::VCalcParser::EXPR || node->GetChildren().size() != 1 ||
+        node->GetChildren()[0]->GetNodeType() != vcalc::VCalcParser::INT){
+        return false;
+    }
+    // literals too big for an int are left for codegen to report
+    long long literal;
+    try {
+        literal = std::stoll(node->GetChildren()[0]->GetText());
+    } catch (const std::exception &) {
+        return false;
+    }
+    if (!FitsInt(literal)){
+        return false;
+    }
+    value = (int32_t)literal;
+    return true;
+}
+
+bool ConstantFolder::GetConstantRange(Ast::Node node, int32_t &lower, int32_t &upper){
+    if (node->GetNodeType() != vcalc::VCalcParser::EXPR || node->GetChildren().size() != 3 ||
+        node->GetChildren()[1]->GetNodeType() != vcalc::VCalcParser::DOTS){
+        return false;
+    }
+    return GetConstant(node->GetChildren()[0], lower) && GetConstant(node->GetChildren()[2], upper);
+}
+
+bool ConstantFolder::FoldIntOperation(size_t op, int32_t lhs, int32_t rhs, int32_t &result){
+    // arithmetic wraps like the generated i32 ops
+    switch (op){
+        case vcalc::VCalcParser::ADD:
+            result = (int32_t)((uint32_t)lhs + (uint32_t)rhs);
+            return true;
+        case vcalc::VCalcParser::SUB:
+            result = (int32_t)((uint32_t)lhs - (uint32_t)rhs);
+            return true;
+        case vcalc::VCalcParser::MUL:
+            result = (int32_t)((uint32_t)lhs * (uint32_t)rhs);
+            return true;
+        case vcalc::VCalcParser::DIV:
+            if (rhs == 0 || (lhs == INT32_MIN && rhs == -1)){
+                return false;
+            }
+            result = lhs / rhs;
+            return true;
+        case vcalc::VCalcParser::LESS:
+            result = lhs < rhs;
+            return true;
+        case vcalc::VCalcParser::GREATER:
+            result = lhs > rhs;
+            return true;
+        case vcalc::VCalcParser::LOGEQ:
+            result = lhs == rhs;
+            return true;
+        case vcalc::VCalcParser::LOGNEQ:
+            result = lhs != rhs;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void ConstantFolder::ReplaceWithConstant(Ast::Node node, int32_t value){
+    Ast::Node int_node = node->GetArena()->NewLeaf(vcalc::VCalcParser::INT, std::to_string(value), node->GetLine());
+    node->SetChildren({int_node});
+}
+
+void ConstantFolder::ReplaceWithRange(Ast::Node node, Ast::Node dots_node,
+                                      int32_t lower, int32_t upper, std::shared_ptr<Symbol::BaseSymbol> int_type){
+    std::vector<Ast::Node> bounds;
+    for (int32_t bound : {lower, upper}){
+        Ast::Node bound_node = node->GetArena()->NewNode(vcalc::VCalcParser::EXPR);
+        bound_node->SetReference(int_type);
+        bound_node->SetScope(node->GetScope());
+        ReplaceWithConstant(bound_node, bound);
+        bounds.push_back(bound_node);
+    }
+    node->SetChildren({bounds[0], dots_node, bounds[1]});
+}
+
+void ConstantFolder::ReplaceWith(Ast::Node node, Ast::Node other){
+    node->SetChildren(other->GetChildren());
+    node->SetReference(other->GetReference());
+}
+
+// LengthInference Visitor methods
+void LengthInference::Infer(Ast::Node root){
+    variable_lengths.clear();
+    for (int pass = 0; pass < max_passes; pass++){
+        changed = false;
+        Visit(root);
+        if (!changed){
+            return;
+        }
+    }
+    // no fixed point, forget every variable length and annotate once more
+    for (auto &variable : variable_lengths){
+        variable.second = -1;
+    }
+    Visit(root);
+}
+
+void LengthInference::VisitBLOCK(Ast::Node current_node){
+    VisitChildren(current_node);
+}
+void LengthInference::VisitIF_BLOCK(Ast::Node current_node){
+    statement_classes.clear();
+    VisitChildren(current_node);
+}
+void LengthInference::VisitLOOP_BLOCK(Ast::Node current_node){
+    statement_classes.clear();
+    VisitChildren(current_node);
+}
+void LengthInference::VisitDECL(Ast::Node current_node){
+    if (current_node->GetChildren().size() == 3){
+        Visit(current_node->GetChildren()[2]);
+        return;
+    }
+    // declared without a value, nothing is known about it
+    auto var_symbol = std::static_pointer_cast<Symbol::VarSymbol>(current_node->GetReference());
+    if (var_symbol->GetTypeSymbol()->IsType(Type::VECTOR)){
+        AssignLength(var_symbol.get(), -1);
+    }
+}
+void LengthInference::VisitASSIGN(Ast::Node current_node){
+    statement_classes.clear();
+    Ast::Node expr_node = current_node->GetChildren()[1];
+    Visit(expr_node);
+    if (IsVector(expr_node)){
+        AssignLength(GetVariable(current_node->GetChildren()[0]), expr_node->GetLength());
+    }
+}
+void LengthInference::VisitPRINT(Ast::Node current_node){
+    statement_classes.clear();
+    VisitChildren(current_node);
+}
+void LengthInference::VisitID(Ast::Node current_node){
+
+}
+void LengthInference::VisitINT(Ast::Node current_node){
+
+}
+
+void LengthInference::VisitEXPR(Ast::Node current_node){
+    VisitChildren(current_node);
+    current_node->SetLength(-1);
+    current_node->SetLengthClass(0);
+    if (!IsVector(current_node)){
+        return;
+    }
+    if (current_node->GetChildren().size() == 1){ // vector variable
+        auto length = variable_lengths.find(GetVariable(current_node->GetChildren()[0]));
+        if (length != variable_lengths.end() && length->second >= 0){
+            SetKnownLength(current_node, length->second);
+        }
+        else{
+            current_node->SetLengthClass(GetClass(ShapeKey(current_node)));
+        }
+        return;
+    }
+
+    Ast::Node left = current_node->GetChildren()[0];
+    Ast::Node right = current_node->GetChildren()[2];
+    int32_t lower, upper;
+    switch (current_node->GetChildren()[1]->GetNodeType()){
+        case vcalc::VCalcParser::DOTS:
+            if (ConstantFolder::GetConstant(left, lower) && ConstantFolder::GetConstant(right, upper)){
+                SetKnownLength(current_node, std::max<int64_t>(0, (int64_t)upper - lower + 1));
+            }
+            else{
+                current_node->SetLengthClass(GetClass(ShapeKey(current_node)));
+            }
+            return;
+        case vcalc::VCalcParser::GENERATOR: // one element per domain element
+            CopyLength(current_node, left);
+            return;
+        case vcalc::VCalcParser::FILTER:
+            return;
+        case vcalc::VCalcParser::INDEX: // one element per index
+            CopyLength(current_node, right);
+            return;
+        default:
+            break;
     }
 
+    // element-wise ops are as long as their longest vector operand
+    if (!IsVector(left)){
+        CopyLength(current_node, right);
+    }
+    else if (!IsVector(right)){
+        CopyLength(current_node, left);
+    }
+    else if (left->GetLengthClass() != 0 && left->GetLengthClass() == right->GetLengthClass()){
+        CopyLength(current_node, left);
+    }
+    else if (left->GetLength() >= 0 && right->GetLength() >= 0){
+        SetKnownLength(current_node, std::max(left->GetLength(), right->GetLength()));
+    }
+}
+
+uint32_t LengthInference::GetClass(const std::string &key){
+    if (key.empty()){
+        return 0;
+    }
+    auto length_class = statement_classes.find(key);
+    if (length_class != statement_classes.end()){
+        return length_class->second;
+    }
+    statement_classes[key] = next_class;
+    return next_class++;
+}
+
+std::string LengthInference::ShapeKey(Ast::Node node){
+    auto children = node->GetChildren();
+    if (children.size() == 1){
+        if (children[0]->GetNodeType() == vcalc::VCalcParser::INT){
+            return children[0]->GetText();
+        }
+        // variables are told apart by symbol, the same name can mean different variables in one statement
+        return "v" + std::to_string((uintptr_t)GetVariable(children[0]));
+    }
+    size_t op = children[1]->GetNodeType();
+    if (op == vcalc::VCalcParser::GENERATOR || op == vcalc::VCalcParser::FILTER){
+        return "";
+    }
+    std::string left_key = ShapeKey(children[0]);
+    std::string right_key = ShapeKey(children[2]);
+    if (left_key.empty() || right_key.empty()){
+        return "";
+    }
+    return "(" + left_key + " " + std::to_string(op) + " " + right_key + ")";
+}
+
+void LengthInference::SetKnownLength(Ast::Node node, int64_t length){
+    if (length > INT32_MAX){ // no vector that long can be built, its length stays unknown
+        return;
+    }
+    node->SetLength(static_cast<int32_t>(length));
+    node->SetLengthClass(GetClass("#" + std::to_string(length)));
+}
+
+void LengthInference::CopyLength(Ast::Node node, Ast::Node other){
+    node->SetLength(other->GetLength());
+    node->SetLengthClass(other->GetLengthClass());
+}
+
+void LengthInference::AssignLength(Symbol::VarSymbol *variable, int64_t length){
+    auto current = variable_lengths.find(variable);
+    if (current == variable_lengths.end()){
+        variable_lengths[variable] = length;
+        changed = true;
+    }
+    else if (current->second != length && current->second != -1){
+        current->second = -1;
+        changed = true;
+    }
+}
+
+Symbol::VarSymbol *LengthInference::GetVariable(Ast::Node id_node){
+    return static_cast<Symbol::VarSymbol *>(id_node->GetReference().get());
+}
+
+bool LengthInference::IsVector(Ast::Node node){
+    auto type_sym = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(node->GetReference());
+    return type_sym->IsType(Type::VECTOR);
+}
 
 // CodeGen Visitor methods
 
-CodeGen::CodeGen(): AstWalker(), BackEnd(){}
+CodeGen::CodeGen(const std::string &prelude_path, bool reusable): AstWalker(), BackEnd(prelude_path, reusable){}
 
-void CodeGen::GenerateMlir(bool dump, std::shared_ptr<Ast::AstNode> current_node){
+void CodeGen::Reset(){
+    BackEnd::Reset();
+    opperands = std::stack<mlir::Value>();
+    frame.clear();
+    frame_slots.clear();
+    hoisted.clear();
+    outlined_loops = 0;
+    current_scope = nullptr;
+}
+
+void CodeGen::GenerateMlir(bool dump, Ast::Node current_node){
     emitModule();
+    // every slot lives in the entry block so loops never grow the stack
+    size_t frame_size = 0;
+    LayoutFrame(current_node, 0, frame_size);
+    for (size_t slot = 0; slot < frame_size; slot++){
+        frame.push_back(builder->create<mlir::LLVM::AllocaOp>(loc, ptr_type, ptr_type, const_one));
+    }
+    if (num_threads > 0){
+        // set before any parallel loop so the pool starts with this many threads
+        mlir::LLVM::LLVMFuncOp set_num_threads = GetRuntimeFunction("vcalcrt_set_num_threads", {int_type});
+        mlir::scf::IfOp if_linked = builder->create<mlir::scf::IfOp>(loc, mlir::TypeRange{}, GenerateRuntimeLinked(set_num_threads), false);
+        builder->setInsertionPointToStart(&if_linked.getThenRegion().front());
+        mlir::Value threads = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, num_threads);
+        builder->create<mlir::LLVM::CallOp>(loc, set_num_threads, mlir::ValueRange{threads});
+        builder->setInsertionPointAfter(if_linked);
+    }
     Visit(current_node);
     builder->create<mlir::LLVM::ReturnOp>(builder->getUnknownLoc(), const_zero);
+    EraseUnusedHelpers();
     if (dump){
         module.dump();
     }
     if (mlir::failed(mlir::verify(module))) {
         module.emitError("module failed to verify");
-        exit(-1);
+        throw std::runtime_error("Generated module failed to verify");
     }
 }
 
-void CodeGen::VisitBLOCK(std::shared_ptr<Ast::AstNode> current_node){
+void CodeGen::SetNumThreads(int threads){
+    num_threads = threads;
+}
+
+void CodeGen::VisitBLOCK(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT BLOCK\n";
     }
     current_scope = current_node->GetScope();
     VisitChildren(current_node);
+    // vector variables of this block go out of scope, free whatever they still hold
+    for (const auto &symbol : current_scope->GetSymbols()){
+        auto var_symbol = std::dynamic_pointer_cast<Symbol::VarSymbol>(symbol.second);
+        if (var_symbol && var_symbol->GetTypeSymbol()->IsType(Type::VECTOR)){
+            FreeVector(builder->create<mlir::LLVM::LoadOp>(loc, ptr_type, var_symbol->GetValue()));
+        }
+    }
     current_scope = current_scope->GetEnclosingScope();
     if (program_flags & DEBUG){
         std::cout << "OUT BLOCK\n";
     }
 }
-void CodeGen::VisitIF_BLOCK(std::shared_ptr<Ast::AstNode> current_node){
+void CodeGen::VisitIF_BLOCK(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT IF_BLOCK\n";
     }
-    Visit(current_node->GetChildren()[0]); // expr node
-    mlir::Value result = opperands.top();
-    opperands.pop();
+    mlir::Value condition = GenerateCondition(current_node->GetChildren()[0]); // expr node
+    // ints assigned in the body flow into the merge block as arguments, either unchanged or from the body
+    std::vector<Symbol::VarSymbol *> carried = CollectAssignedInts(current_node->GetChildren()[1]);
 
     mlir::Block *if_block = main_func.addBlock();
     mlir::Block *merge = main_func.addBlock();
 
-    mlir::Value condition = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::ne, result, const_zero);
-    builder->create<mlir::LLVM::CondBrOp>(loc, condition, if_block, merge);
+    builder->create<mlir::LLVM::CondBrOp>(loc, condition, if_block, mlir::ValueRange{}, merge, mlir::ValueRange(GetValues(carried)));
     builder->setInsertionPointToStart(if_block);
     Visit(current_node->GetChildren()[1]); // visit block child
-    builder->create<mlir::LLVM::BrOp>(loc, merge);
+    builder->create<mlir::LLVM::BrOp>(loc, mlir::ValueRange(GetValues(carried)), merge);
     builder->setInsertionPointToStart(merge);
+    BindBlockArguments(merge, carried);
 
     if (program_flags & DEBUG){
         std::cout << "OUT IF_BLOCK\n";
     }
 
 }
-void CodeGen::VisitLOOP_BLOCK(std::shared_ptr<Ast::AstNode> current_node){
+void CodeGen::VisitLOOP_BLOCK(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT LOOP_BLOCK\n";
     }
-    mlir::Block *header = main_func.addBlock();
-    mlir::Block *body = main_func.addBlock();
-    mlir::Block *merge = main_func.addBlock();
-    builder->create<mlir::LLVM::BrOp>(loc, header);
-    
-    builder->setInsertionPointToStart(header);
-    Visit(current_node->GetChildren()[0]); // expr node
-    mlir::Value result = opperands.top();
-    opperands.pop();
-    mlir::Value condition = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::ne, result, const_zero);
-    builder->create<mlir::LLVM::CondBrOp>(loc, condition, body, merge);
-    builder->setInsertionPointToStart(body);
-    Visit(current_node->GetChildren()[1]);
-    builder->create<mlir::LLVM::BrOp>(loc, header);
-    builder->setInsertionPointToStart(merge);
+    // ints assigned in the body are loop-carried through block arguments
+    std::vector<Symbol::VarSymbol *> carried = CollectAssignedInts(current_node->GetChildren()[1]);
+
+    // vector exprs that read nothing the loop assigns are computed once in front of it
+    std::vector<Symbol::VarSymbol *> assigned;
+    CollectAssigned(current_node->GetChildren()[1], assigned);
+    std::vector<Ast::Node> invariants;
+    CollectLoopInvariants(current_node->GetChildren()[0], current_node, assigned, invariants);
+    CollectLoopInvariants(current_node->GetChildren()[1], current_node, assigned, invariants);
+
+    if (invariants.empty()){
+        mlir::Block *header = main_func.addBlock();
+        mlir::Block *body = main_func.addBlock();
+        mlir::Block *merge = main_func.addBlock();
+        builder->create<mlir::LLVM::BrOp>(loc, mlir::ValueRange(GetValues(carried)), header);
+
+        builder->setInsertionPointToStart(header);
+        BindBlockArguments(header, carried);
+        mlir::Value condition = GenerateCondition(current_node->GetChildren()[0]); // expr node
+        builder->create<mlir::LLVM::CondBrOp>(loc, condition, body, merge);
+        builder->setInsertionPointToStart(body);
+        Visit(current_node->GetChildren()[1]);
+        builder->create<mlir::LLVM::BrOp>(loc, mlir::ValueRange(GetValues(carried)), header);
+        builder->setInsertionPointToStart(merge);
+        // the loop only exits from the header
+        for (size_t i = 0; i < carried.size(); i++){
+            carried[i]->SetValue(header->getArgument(i));
+        }
+    }
+    else{
+        // the loop is rotated so the invariants are only computed once the condition has held, a loop that runs
+        // zero times allocates nothing. The first test computes what it reads itself, later ones use the invariants
+        mlir::Block *preheader = main_func.addBlock();
+        mlir::Block *body = main_func.addBlock();
+        mlir::Block *exit = main_func.addBlock();
+        mlir::Block *merge = main_func.addBlock();
+        mlir::Value entered = GenerateCondition(current_node->GetChildren()[0]); // expr node
+        builder->create<mlir::LLVM::CondBrOp>(loc, entered, preheader, mlir::ValueRange{}, merge, mlir::ValueRange(GetValues(carried)));
+
+        builder->setInsertionPointToStart(preheader);
+        std::shared_ptr<Scope::BaseScope> loop_scope = current_scope;
+        for (const auto &invariant : invariants){
+            current_scope = invariant->GetScope();
+            Visit(invariant);
+            hoisted[invariant] = opperands.top();
+            opperands.pop();
+        }
+        current_scope = loop_scope;
+        builder->create<mlir::LLVM::BrOp>(loc, mlir::ValueRange(GetValues(carried)), body);
+
+        builder->setInsertionPointToStart(body);
+        BindBlockArguments(body, carried);
+        Visit(current_node->GetChildren()[1]);
+        mlir::Value condition = GenerateCondition(current_node->GetChildren()[0]);
+        builder->create<mlir::LLVM::CondBrOp>(loc, condition, body, mlir::ValueRange(GetValues(carried)), exit, mlir::ValueRange{});
+
+        builder->setInsertionPointToStart(exit);
+        for (const auto &invariant : invariants){
+            FreeVector(hoisted[invariant]);
+            hoisted.erase(invariant);
+        }
+        builder->create<mlir::LLVM::BrOp>(loc, mlir::ValueRange(GetValues(carried)), merge);
+        // the loop exits before the first iteration or after the last
+        builder->setInsertionPointToStart(merge);
+        BindBlockArguments(merge, carried);
+    }
     if (program_flags & DEBUG){
         std::cout << "OUT LOOP_BLOCK\n";
     }
 }
-void CodeGen::VisitDECL(std::shared_ptr<Ast::AstNode> current_node){
+void CodeGen::VisitDECL(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT DECL\n";
     }
     auto var_symbol = std::static_pointer_cast<Symbol::VarSymbol>(current_node->GetReference());
     if (var_symbol->GetTypeSymbol()->IsType(Type::INT)){
-        var_symbol->SetValue(builder->create<mlir::LLVM::AllocaOp>(loc, ptr_type, int_type, const_one));
-
+        // ints are SSA values rather than stack slots, one declared without a value reads as 0
+        var_symbol->SetValue(const_zero);
     }
     else if (var_symbol->GetTypeSymbol()->IsType(Type::VECTOR)){
-        var_symbol->SetValue(builder->create<mlir::LLVM::AllocaOp>(loc, ptr_type, ptr_type, const_one));
+        var_symbol->SetValue(frame[frame_slots[var_symbol.get()]]);
+        // start out null so the first assignment and the end of scope can free unconditionally
+        builder->create<mlir::LLVM::StoreOp>(loc, GenerateNullPtr(), var_symbol->GetValue());
     }
     else{
-        std::cout << "ERROR IN DECL\n";
-        throw -1;
+        throw std::runtime_error("Unsupported declaration type at line " + std::to_string(current_node->GetLine()));
     }
     if (current_node->GetChildren().size() == 3){
         Visit(current_node->GetChildren()[2]);
@@ -434,24 +911,42 @@ void CodeGen::VisitDECL(std::shared_ptr<Ast::AstNode> current_node){
         std::cout << "OUT DECL\n";
     }
 }
-void CodeGen::VisitASSIGN(std::shared_ptr<Ast::AstNode> current_node){
+void CodeGen::VisitASSIGN(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT ASSIGN\n";
     }
     Visit(current_node->GetChildren()[1]);
     mlir::Value result = opperands.top(); // generator not pushing
     opperands.pop();
-    // need to free here
-    auto variable = std::static_pointer_cast<Symbol::VarSymbol>(current_scope->Resolve(current_node->GetChildren()[0]->GetText()));
-    builder->create<mlir::LLVM::StoreOp>(loc, result, variable->GetValue());
+    auto variable = std::static_pointer_cast<Symbol::VarSymbol>(current_node->GetChildren()[0]->GetReference());
+    if (variable->GetTypeSymbol()->IsType(Type::VECTOR)){
+        // the variable owns its vector, so another variable's vector is copied rather than shared
+        if (!IsOwnedVector(current_node->GetChildren()[1])){
+            mlir::LLVM::LLVMFuncOp copy_func = GetHelper("vector_copy");
+            result = builder->create<mlir::LLVM::CallOp>(loc, copy_func, mlir::ValueRange{result}).getResult();
+        }
+        FreeVector(builder->create<mlir::LLVM::LoadOp>(loc, ptr_type, variable->GetValue()));
+        builder->create<mlir::LLVM::StoreOp>(loc, result, variable->GetValue());
+    }
+    else{
+        variable->SetValue(result);
+    }
     if (program_flags & DEBUG){
         std::cout << "OUT ASSIGN\n";
     }
 }
-void CodeGen::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
+void CodeGen::VisitEXPR(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT EXPR\n";
     }
+    auto hoisted_value = hoisted.find(current_node);
+    if (hoisted_value != hoisted.end()){ // computed before the enclosing loop
+        opperands.push(hoisted_value->second);
+        if (program_flags & DEBUG){
+            std::cout << "OUT EXPR\n";
+        }
+        return;
+    }
     if (current_node->GetChildren().size() == 1) { // (expr), ID & INT
         VisitChildren(current_node);
         if (program_flags & DEBUG){
@@ -460,8 +955,18 @@ void CodeGen::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
         return;
     }
 
-    std::shared_ptr<Ast::AstNode> right = current_node->GetChildren()[2];
-    std::shared_ptr<Ast::AstNode> left = current_node->GetChildren()[0];
+    // chains of element-wise vector ops are computed in one loop, so are single ops on a range to keep it lazy
+    if (CountElementWise(current_node) >= 2 || (IsElementWise(current_node) &&
+        (IsRange(current_node->GetChildren()[0]) || IsRange(current_node->GetChildren()[2])))){
+        opperands.push(GenerateFusedExpr(current_node));
+        if (program_flags & DEBUG){
+            std::cout << "OUT EXPR\n";
+        }
+        return;
+    }
+
+    Ast::Node right = current_node->GetChildren()[2];
+    Ast::Node left = current_node->GetChildren()[0];
     mlir::ValueRange args; 
     mlir::Value result;
     size_t op_type = current_node->GetChildren()[1]->GetNodeType();
@@ -472,30 +977,13 @@ void CodeGen::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
     mlir::Value l_opperand;
 
     if (op_type == vcalc::VCalcParser::GENERATOR || op_type == vcalc::VCalcParser::FILTER){ // left child vector, right child int
-        Visit(left);
-        mlir::Value gen_filter_vector = opperands.top();
-        opperands.pop();
+        // the domain is read through a view so a range domain is never allocated
+        VectorView domain = GenerateVectorView(left);
         current_scope = current_node->GetChildren()[1]->GetChildren()[0]->GetScope();
-        auto iterator_sym = std::static_pointer_cast<Symbol::VarSymbol>(current_node->GetChildren()[1]->GetChildren()[0]->GetReference());
-        iterator_sym->SetValue(builder->create<mlir::LLVM::AllocaOp>(loc, ptr_type, int_type, const_one));
-        mlir::Value gen_filter_index = iterator_sym->GetValue();
 
-        mlir::Value size_addr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, gen_filter_vector, mlir::ValueRange{const_zero});
-        mlir::Value size = builder->create<mlir::LLVM::LoadOp>(loc, int_type, size_addr);
+        mlir::Value size = domain.size;
 
         result = GenerateVectorTypePtr(size);
-        mlir::Value result_size_ptr;
-
-        if (op_type == vcalc::VCalcParser::FILTER){ 
-            result_size_ptr = builder->create<mlir::LLVM::GEPOp>(
-                loc,
-                ptr_type,
-                int_type,
-                result,
-                mlir::ValueRange{const_zero}
-            );
-            builder->create<mlir::LLVM::StoreOp>(loc, const_zero, result_size_ptr);
-        }
         mlir::Value result_arr_ptr = builder->create<mlir::LLVM::GEPOp>(
             loc,
             ptr_type,
@@ -504,55 +992,51 @@ void CodeGen::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
             mlir::ValueRange{const_one}
         );
 
-        mlir::scf::ForOp for_loop = builder->create<mlir::scf::ForOp>(loc, const_zero, size, const_one);
-        mlir::Value loop_index = for_loop.getInductionVar();
-        mlir::Block *for_loop_body = for_loop.getBody();
-        mlir::OpBuilder::InsertPoint save = builder->saveInsertionPoint();
-        builder->setInsertionPointToStart(for_loop_body);
-        // set iterator
-        op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_index");
-        args = {gen_filter_vector, loop_index};
-        mlir::Value gen_filter_vector_elem = builder->create<mlir::LLVM::CallOp>(loc, op_func, args).getResult();
-        builder->create<mlir::LLVM::StoreOp>(loc, gen_filter_vector_elem, gen_filter_index);
-    
-        Visit(right);
-        // set result index
-        mlir::Value gen_filter_expr_result = opperands.top();
-        opperands.pop();
+        // the loop lives in its own function so large domains can be split over the vcalcrt thread pool,
+        // everything else calls it directly over the whole domain
+        mlir::Value env;
+        mlir::LLVM::LLVMFuncOp loop_func = OutlineGeneratorLoop(current_node, domain, result_arr_ptr, env);
+        mlir::Value loop_func_ptr = builder->create<mlir::LLVM::AddressOfOp>(loc, loop_func);
+        mlir::Value threshold = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, parallel_threshold);
+        mlir::Value is_large = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::sge, size, threshold);
 
-        mlir::Value arr_index_ptr;
-        if (op_type == vcalc::VCalcParser::FILTER){ // filter use cmp op
-            mlir::Value condition = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::ne, gen_filter_expr_result, const_zero);
-            mlir::scf::IfOp if_statement = builder->create<mlir::scf::IfOp>(loc, condition);
-            mlir::Block *if_body = if_statement.getBody();
+        if (op_type == vcalc::VCalcParser::FILTER){
+            mlir::LLVM::LLVMFuncOp parallel_filter = GetRuntimeFunction(
+                "vcalcrt_parallel_filter", {ptr_type, ptr_type, ptr_type, int_type}, int_type);
+            mlir::Value use_pool = builder->create<mlir::LLVM::AndOp>(loc, is_large, GenerateRuntimeLinked(parallel_filter));
+            mlir::scf::IfOp if_pool = builder->create<mlir::scf::IfOp>(loc, mlir::TypeRange{int_type}, use_pool, true);
             mlir::OpBuilder::InsertPoint save = builder->saveInsertionPoint();
-            builder->setInsertionPointToStart(if_body);
-            mlir::Value result_size = builder->create<mlir::LLVM::LoadOp>(loc, int_type, result_size_ptr);
-            arr_index_ptr = builder->create<mlir::LLVM::GEPOp>(
-                loc,
-                ptr_type,
-                int_type,
-                result_arr_ptr,
-                mlir::ValueRange{result_size}
-            );
-
-            builder->create<mlir::LLVM::StoreOp>(loc, gen_filter_vector_elem, arr_index_ptr);
-            mlir::Value new_size = builder->create<mlir::LLVM::AddOp>(loc, result_size, const_one);
-            builder->create<mlir::LLVM::StoreOp>(loc, new_size, result_size_ptr);
-
+            builder->setInsertionPointToStart(&if_pool.getThenRegion().front());
+            mlir::Value pool_kept = builder->create<mlir::LLVM::CallOp>(
+                loc, parallel_filter, mlir::ValueRange{loop_func_ptr, env, result_arr_ptr, size}).getResult();
+            builder->create<mlir::scf::YieldOp>(loc, pool_kept);
+            builder->setInsertionPointToStart(&if_pool.getElseRegion().front());
+            mlir::Value kept = builder->create<mlir::LLVM::CallOp>(
+                loc, loop_func, mlir::ValueRange{env, const_zero, size, result_arr_ptr}).getResult();
+            builder->create<mlir::scf::YieldOp>(loc, kept);
             builder->restoreInsertionPoint(save);
+
+            // shrink the buffer down to what was kept
+            mlir::Value result_size = if_pool.getResult(0);
+            mlir::Value result_size_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, result, mlir::ValueRange{const_zero});
+            builder->create<mlir::LLVM::StoreOp>(loc, result_size, result_size_ptr);
+            result = ShrinkVector(result, result_size);
         }
         else{
-            arr_index_ptr = builder->create<mlir::LLVM::GEPOp>(
-                loc,
-                ptr_type,
-                int_type,
-                result_arr_ptr,
-                mlir::ValueRange{loop_index}
-            );
-            builder->create<mlir::LLVM::StoreOp>(loc, gen_filter_expr_result, arr_index_ptr);
+            mlir::LLVM::LLVMFuncOp parallel_generator = GetRuntimeFunction(
+                "vcalcrt_parallel_generator", {ptr_type, ptr_type, int_type});
+            mlir::Value use_pool = builder->create<mlir::LLVM::AndOp>(loc, is_large, GenerateRuntimeLinked(parallel_generator));
+            mlir::scf::IfOp if_pool = builder->create<mlir::scf::IfOp>(loc, mlir::TypeRange{}, use_pool, true);
+            mlir::OpBuilder::InsertPoint save = builder->saveInsertionPoint();
+            builder->setInsertionPointToStart(&if_pool.getThenRegion().front());
+            builder->create<mlir::LLVM::CallOp>(loc, parallel_generator, mlir::ValueRange{loop_func_ptr, env, size});
+            builder->setInsertionPointToStart(&if_pool.getElseRegion().front());
+            builder->create<mlir::LLVM::CallOp>(loc, loop_func, mlir::ValueRange{env, const_zero, size});
+            builder->restoreInsertionPoint(save);
+        }
+        if (domain.vector){
+            FreeIfOwned(left, domain.vector);
         }
-        builder->restoreInsertionPoint(save);
 
         opperands.push(result);
         current_scope = current_scope->GetEnclosingScope();
@@ -562,6 +1046,14 @@ void CodeGen::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
         return;
     }
 
+    if (op_type == vcalc::VCalcParser::INDEX && (IsRange(left) || IsRange(right))){
+        opperands.push(GenerateLazyIndex(current_node));
+        if (program_flags & DEBUG){
+            std::cout << "OUT EXPR\n";
+        }
+        return;
+    }
+
     VisitChildren(current_node);
     r_opperand = opperands.top();
     opperands.pop();
@@ -570,11 +1062,11 @@ void CodeGen::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
 
     if (op_type == vcalc::VCalcParser::INDEX){ // left child vector, right child int or vector
         if (r_opperand_sym->IsType(Type::INT)){
-            op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_index");
+            op_func = GetHelper("vector_index");
         }
         
         else if (r_opperand_sym->IsType(Type::VECTOR)){
-            op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_index_vector");
+            op_func = GetHelper("vector_index_vector");
         }
         
         args = {l_opperand, r_opperand};
@@ -582,160 +1074,603 @@ void CodeGen::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
         
     }
     else if (op_type == vcalc::VCalcParser::DOTS){ // both children ints
-        op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_range");
+        op_func = GetHelper("vector_range");
         args = {l_opperand, r_opperand};
         result = builder->create<mlir::LLVM::CallOp>(loc, op_func, args).getResult();
     }
     else if (l_opperand_sym->IsType(Type::INT) && r_opperand_sym->IsType(Type::INT)){
-        switch (op_type) {
-            case vcalc::VCalcParser::ADD:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("int_add");
-                break;
-            case vcalc::VCalcParser::SUB:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("int_sub"); 
-                break;
-            case vcalc::VCalcParser::MUL:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("int_mul");
-                break;
-            case vcalc::VCalcParser::DIV:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("int_div");
-                break;
-            case vcalc::VCalcParser::LESS:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("int_less_than");
-                break;
-            case vcalc::VCalcParser::GREATER:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("int_greater_than");
-                break;
-            case vcalc::VCalcParser::LOGEQ:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("int_equal"); 
-                break;
-            case vcalc::VCalcParser::LOGNEQ:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("int_nequal"); 
-                break;
-            default:
-                break;
-        }
-        args = {l_opperand, r_opperand};
-        result = builder->create<mlir::LLVM::CallOp>(loc, op_func, args).getResult();
+        result = CreateIntOperation(op_type, l_opperand, r_opperand);
     }
-    else if (l_opperand_sym->IsType(Type::VECTOR) && r_opperand_sym->IsType(Type::INT)){
-        mlir::LLVM::LLVMFuncOp promotion_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("int_to_vector");
-        mlir::Value size_addr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, l_opperand, mlir::ValueRange{const_zero});
-        mlir::Value size = builder->create<mlir::LLVM::LoadOp>(loc, int_type, size_addr);
-        args = {size, r_opperand};
-        mlir::Value promoted_int = builder->create<mlir::LLVM::CallOp>(loc, promotion_func, args).getResult();
-        switch (op_type) {
-            case vcalc::VCalcParser::ADD:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_add");
-                break;
-            case vcalc::VCalcParser::SUB:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_sub");
-                break;
-            case vcalc::VCalcParser::MUL:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_mul");
-                break;
-            case vcalc::VCalcParser::DIV:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_div");
-                break;
-            case vcalc::VCalcParser::LESS:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_less_than");
-                break;
-            case vcalc::VCalcParser::GREATER:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_greater_than");
-                break;
-            case vcalc::VCalcParser::LOGEQ:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_equal"); 
-                break;
-            case vcalc::VCalcParser::LOGNEQ:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_nequal"); 
-                break;
-            default:
-                break;
-        }
-        args = {l_opperand, promoted_int};
+    else if (l_opperand_sym->IsType(Type::VECTOR) && r_opperand_sym->IsType(Type::INT)){ // int is broadcast inside the kernel
+        op_func = GetHelper(GetScalarOperationFunc(op_type, false));
+        args = {l_opperand, r_opperand};
         result = builder->create<mlir::LLVM::CallOp>(loc, op_func, args).getResult();
-        
     }
     else if (l_opperand_sym->IsType(Type::INT) && r_opperand_sym->IsType(Type::VECTOR)){
-        mlir::LLVM::LLVMFuncOp promotion_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("int_to_vector");
-        mlir::Value size_addr = builder->create<mlir::LLVM::GEPOp>(
-            loc, ptr_type, int_type, r_opperand, mlir::ValueRange{const_zero});
-        mlir::Value size = builder->create<mlir::LLVM::LoadOp>(loc, int_type, size_addr);
-        args = {size, l_opperand};
-        mlir::Value promoted_int = builder->create<mlir::LLVM::CallOp>(loc, promotion_func, args).getResult();
-        switch (op_type) {
-            case vcalc::VCalcParser::ADD:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_add");
-                break;
-            case vcalc::VCalcParser::SUB:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_sub"); 
-                break;
-            case vcalc::VCalcParser::MUL:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_mul");
-                break;
-            case vcalc::VCalcParser::DIV:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_div");
-                break;
-            case vcalc::VCalcParser::LESS:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_less_than");
-                break;
-            case vcalc::VCalcParser::GREATER:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_greater_than");
-                break;
-            case vcalc::VCalcParser::LOGEQ:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_equal"); 
-                break;
-            case vcalc::VCalcParser::LOGNEQ:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_nequal"); 
-                break;
-            default:
-                break;
-        }
-        args = {promoted_int, r_opperand};
+        op_func = GetHelper(GetScalarOperationFunc(op_type, true));
+        args = {l_opperand, r_opperand};
         result = builder->create<mlir::LLVM::CallOp>(loc, op_func, args).getResult();
     }
     else if (l_opperand_sym->IsType(Type::VECTOR) && r_opperand_sym->IsType(Type::VECTOR)){
-        switch (op_type) {
-            case vcalc::VCalcParser::ADD:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_add");
-                break;
-            case vcalc::VCalcParser::SUB:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_sub"); 
-                break;
-            case vcalc::VCalcParser::MUL:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_mul");
-                break;
-            case vcalc::VCalcParser::DIV:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_div");
-                break;
-            case vcalc::VCalcParser::LESS:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_less_than");
-                break;
-            case vcalc::VCalcParser::GREATER:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_greater_than");
-                break;
-            case vcalc::VCalcParser::LOGEQ:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_equal"); 
-                break;
-            case vcalc::VCalcParser::LOGNEQ:
-                op_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_nequal"); 
-                break;
-            default:
-                break;
+        std::string func_name = GetOperationFunc(op_type, Type::VCalcTypes::VECTOR);
+        if (SameLength(left, right)){ // no padding possible, skip match_vector_size
+            func_name += "_unchecked";
         }
+        op_func = GetHelper(func_name);
         args = {l_opperand, r_opperand};
         result = builder->create<mlir::LLVM::CallOp>(loc, op_func, args).getResult();
     }
     else{
-        std::cerr << "error if we get here\n";
-        exit(-1);
+        throw std::runtime_error("Unsupported operand types at line " + std::to_string(current_node->GetLine()));
     }
+    FreeIfOwned(left, l_opperand);
+    FreeIfOwned(right, r_opperand);
     opperands.push(result);
     if (program_flags & DEBUG){
         std::cout << "OUT EXPR\n";
     }
 }
-void CodeGen::VisitPRINT(std::shared_ptr<Ast::AstNode> current_node){
+
+mlir::LLVM::LLVMFuncOp CodeGen::OutlineGeneratorLoop(Ast::Node node, const VectorView &domain,
+                                                     mlir::Value result_arr_ptr, mlir::Value &env){
+    bool is_filter = node->GetChildren()[1]->GetNodeType() == vcalc::VCalcParser::FILTER;
+    auto iterator_sym = std::static_pointer_cast<Symbol::VarSymbol>(node->GetChildren()[1]->GetChildren()[0]->GetReference());
+    Ast::Node right = node->GetChildren()[2];
+
+    mlir::LLVM::LLVMFunctionType type;
+    std::string name;
+    if (is_filter){
+        type = mlir::LLVM::LLVMFunctionType::get(int_type, {ptr_type, int_type, int_type, ptr_type});
+        name = "filter_loop_" + std::to_string(outlined_loops++);
+    }
+    else{
+        type = mlir::LLVM::LLVMFunctionType::get(mlir::LLVM::LLVMVoidType::get(&context), {ptr_type, int_type, int_type});
+        name = "generator_loop_" + std::to_string(outlined_loops++);
+    }
+
+    mlir::OpBuilder::InsertPoint use_site = builder->saveInsertionPoint();
+    builder->setInsertionPointToEnd(module.getBody());
+    auto func = builder->create<mlir::LLVM::LLVMFuncOp>(loc, name, type, mlir::LLVM::Linkage::Internal);
+    mlir::Block *entry = func.addEntryBlock();
+    builder->setInsertionPointToStart(entry);
+    mlir::Value begin = entry->getArgument(1);
+    mlir::Value end = entry->getArgument(2);
+
+    // the body is generated exactly as it would be inline, captures are fixed up below
+    if (is_filter){
+        // kept elements are compacted to the front of out, the count of kept elements is carried through the loop
+        mlir::Value out = entry->getArgument(3);
+        mlir::scf::ForOp for_loop = builder->create<mlir::scf::ForOp>(loc, begin, end, const_one, mlir::ValueRange{const_zero});
+        mlir::Value loop_index = for_loop.getInductionVar();
+        mlir::Value kept = for_loop.getRegionIterArgs()[0];
+        builder->setInsertionPointToStart(for_loop.getBody());
+        // set iterator, the loop stays within the domain so its elements are read directly
+        mlir::Value gen_filter_vector_elem = GenerateViewElement(domain, loop_index);
+        iterator_sym->SetValue(gen_filter_vector_elem);
+
+        mlir::Value condition = GenerateCondition(right);
+        mlir::scf::IfOp if_statement = builder->create<mlir::scf::IfOp>(loc, mlir::TypeRange{int_type}, condition, true);
+        builder->setInsertionPointToStart(&if_statement.getThenRegion().front());
+        mlir::Value arr_index_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, out, mlir::ValueRange{kept});
+        builder->create<mlir::LLVM::StoreOp>(loc, gen_filter_vector_elem, arr_index_ptr);
+        mlir::Value new_kept = builder->create<mlir::LLVM::AddOp>(loc, kept, const_one);
+        builder->create<mlir::scf::YieldOp>(loc, new_kept);
+        builder->setInsertionPointToStart(&if_statement.getElseRegion().front());
+        builder->create<mlir::scf::YieldOp>(loc, kept);
+
+        builder->setInsertionPointAfter(if_statement);
+        builder->create<mlir::scf::YieldOp>(loc, if_statement.getResult(0));
+        builder->setInsertionPointAfter(for_loop);
+        builder->create<mlir::LLVM::ReturnOp>(loc, for_loop.getResult(0));
+    }
+    else{
+        mlir::scf::ForOp for_loop = builder->create<mlir::scf::ForOp>(loc, begin, end, const_one);
+        mlir::Value loop_index = for_loop.getInductionVar();
+        builder->setInsertionPointToStart(for_loop.getBody());
+        // set iterator, the loop stays within the domain so its elements are read directly
+        mlir::Value gen_filter_vector_elem = GenerateViewElement(domain, loop_index);
+        iterator_sym->SetValue(gen_filter_vector_elem);
+
+        Visit(right);
+        // set result index
+        mlir::Value gen_filter_expr_result = opperands.top();
+        opperands.pop();
+        mlir::Value arr_index_ptr = builder->create<mlir::LLVM::GEPOp>(
+            loc,
+            ptr_type,
+            int_type,
+            result_arr_ptr,
+            mlir::ValueRange{loop_index}
+        );
+        builder->create<mlir::LLVM::StoreOp>(loc, gen_filter_expr_result, arr_index_ptr);
+        builder->setInsertionPointAfter(for_loop);
+        builder->create<mlir::LLVM::ReturnOp>(loc, mlir::ValueRange{});
+    }
+
+    // values defined outside of func (the domain, the result, variables, hoisted vectors, constants) are captured,
+    // constants are cloned into func and everything else is loaded from a field of env
+    llvm::SetVector<mlir::Value> captures;
+    func.walk([&](mlir::Operation *op){
+        for (mlir::Value operand : op->getOperands()){
+            if (!func.getBody().isAncestor(operand.getParentRegion())){
+                captures.insert(operand);
+            }
+        }
+    });
+    std::vector<mlir::Value> captured;
+    std::vector<mlir::Type> captured_types;
+    builder->setInsertionPointToStart(entry);
+    for (mlir::Value value : captures){
+        if (auto constant = value.getDefiningOp<mlir::LLVM::ConstantOp>()){
+            mlir::replaceAllUsesInRegionWith(value, builder->clone(*constant)->getResult(0), func.getBody());
+        }
+        else{
+            captured.push_back(value);
+            captured_types.push_back(value.getType());
+        }
+    }
+    auto env_type = mlir::LLVM::LLVMStructType::getLiteral(&context, captured_types);
+    for (size_t field = 0; field < captured.size(); field++){
+        mlir::Value field_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, env_type, entry->getArgument(0),
+            llvm::ArrayRef<mlir::LLVM::GEPArg>{0, static_cast<int32_t>(field)});
+        mlir::Value field_value = builder->create<mlir::LLVM::LoadOp>(loc, captured_types[field], field_ptr);
+        mlir::replaceAllUsesInRegionWith(captured[field], field_value, func.getBody());
+    }
+
+    builder->restoreInsertionPoint(use_site);
+    if (captured.empty()){
+        env = GenerateNullPtr();
+        return func;
+    }
+    // env is allocated in the entry block of the enclosing function, a generator inside a loop reuses it
+    mlir::Operation *parent = builder->getInsertionBlock()->getParentOp();
+    auto enclosing_func = llvm::isa<mlir::LLVM::LLVMFuncOp>(parent) ? llvm::cast<mlir::LLVM::LLVMFuncOp>(parent)
+                                                                    : parent->getParentOfType<mlir::LLVM::LLVMFuncOp>();
+    {
+        mlir::OpBuilder::InsertionGuard guard(*builder);
+        builder->setInsertionPointToStart(&enclosing_func.getBody().front());
+        mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
+        env = builder->create<mlir::LLVM::AllocaOp>(loc, ptr_type, env_type, one);
+    }
+    for (size_t field = 0; field < captured.size(); field++){
+        mlir::Value field_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, env_type, env,
+            llvm::ArrayRef<mlir::LLVM::GEPArg>{0, static_cast<int32_t>(field)});
+        builder->create<mlir::LLVM::StoreOp>(loc, captured[field], field_ptr);
+    }
+    return func;
+}
+
+void CodeGen::LayoutFrame(Ast::Node node, size_t first_free, size_t &frame_size){
+    if (node->GetNodeType() == vcalc::VCalcParser::BLOCK){
+        // the block's own variables come first, nested blocks stack on top of them and siblings reuse the same slots
+        for (const auto &child : node->GetChildren()){
+            if (child->GetNodeType() != vcalc::VCalcParser::DECL){
+                continue;
+            }
+            auto var_symbol = std::static_pointer_cast<Symbol::VarSymbol>(child->GetReference());
+            if (var_symbol->GetTypeSymbol()->IsType(Type::VECTOR)){
+                frame_slots[var_symbol.get()] = first_free++;
+            }
+        }
+        frame_size = std::max(frame_size, first_free);
+    }
+    for (const auto &child : node->GetChildren()){
+        LayoutFrame(child, first_free, frame_size);
+    }
+}
+
+bool CodeGen::IsIntBoolOperation(size_t op){
+    return op == vcalc::VCalcParser::LESS || op == vcalc::VCalcParser::GREATER ||
+           op == vcalc::VCalcParser::LOGEQ || op == vcalc::VCalcParser::LOGNEQ;
+}
+
+mlir::Value CodeGen::GenerateCondition(Ast::Node expr_node){
+    // int comparisons produce the i1 directly so we can branch on it without materializing 0/1
+    if (expr_node->GetChildren().size() == 3 && IsIntBoolOperation(expr_node->GetChildren()[1]->GetNodeType())){
+        auto l_opperand_sym = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(expr_node->GetChildren()[0]->GetReference());
+        auto r_opperand_sym = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(expr_node->GetChildren()[2]->GetReference());
+        if (l_opperand_sym->IsType(Type::INT) && r_opperand_sym->IsType(Type::INT)){
+            Visit(expr_node->GetChildren()[0]);
+            Visit(expr_node->GetChildren()[2]);
+            mlir::Value r_opperand = opperands.top();
+            opperands.pop();
+            mlir::Value l_opperand = opperands.top();
+            opperands.pop();
+            return CreateIntPredicate(expr_node->GetChildren()[1]->GetNodeType(), l_opperand, r_opperand);
+        }
+    }
+    Visit(expr_node);
+    mlir::Value result = opperands.top();
+    opperands.pop();
+    return builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::ne, result, const_zero);
+}
+
+std::vector<Symbol::VarSymbol *> CodeGen::CollectAssignedInts(Ast::Node node){
+    std::vector<Symbol::VarSymbol *> variables;
+    CollectAssigned(node, variables);
+    variables.erase(std::remove_if(variables.begin(), variables.end(), [](Symbol::VarSymbol *variable){
+        return !variable->GetTypeSymbol()->IsType(Type::INT);
+    }), variables.end());
+    return variables;
+}
+
+void CodeGen::CollectAssigned(Ast::Node node, std::vector<Symbol::VarSymbol *> &variables){
+    if (node->GetNodeType() == vcalc::VCalcParser::ASSIGN){
+        // the variable DefRef bound to the assignment's ID
+        auto variable = std::dynamic_pointer_cast<Symbol::VarSymbol>(node->GetChildren()[0]->GetReference());
+        // variables declared inside node have no value yet and are not visible after it
+        if (variable && variable->GetValue() &&
+            std::find(variables.begin(), variables.end(), variable.get()) == variables.end()){
+            variables.push_back(variable.get());
+        }
+    }
+    for (const auto &child : node->GetChildren()){
+        CollectAssigned(child, variables);
+    }
+}
+
+void CodeGen::CollectLoopInvariants(Ast::Node node, Ast::Node parent,
+                                    const std::vector<Symbol::VarSymbol *> &assigned,
+                                    std::vector<Ast::Node> &invariants){
+    if (hoisted.count(node)){ // already hoisted out of an enclosing loop
+        return;
+    }
+    // only what every iteration computes is hoisted. Under an if or in a nested loop it may never be computed, and
+    // could be too large to allocate at all
+    if (node->GetNodeType() == vcalc::VCalcParser::IF_BLOCK || node->GetNodeType() == vcalc::VCalcParser::LOOP_BLOCK){
+        return;
+    }
+    size_t unconditional = node->GetChildren().size();
+    if (node->GetNodeType() == vcalc::VCalcParser::EXPR && node->GetChildren().size() == 3){
+        auto type_sym = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(node->GetReference());
+        // a range is lazy and only allocates when it escapes, printing is the one escape a hoist saves
+        bool allocates = !IsRange(node) || parent->GetNodeType() == vcalc::VCalcParser::PRINT;
+        if (type_sym->IsType(Type::VECTOR) && allocates && IsLoopInvariant(node, assigned, {})){
+            invariants.push_back(node);
+            return;
+        }
+        // the body of a generator or filter only runs for the elements of a domain that may be empty
+        size_t op = node->GetChildren()[1]->GetNodeType();
+        if (op == vcalc::VCalcParser::GENERATOR || op == vcalc::VCalcParser::FILTER){
+            unconditional = 1;
+        }
+    }
+    for (size_t i = 0; i < unconditional; i++){
+        CollectLoopInvariants(node->GetChildren()[i], node, assigned, invariants);
+    }
+}
+
+bool CodeGen::IsLoopInvariant(Ast::Node node, const std::vector<Symbol::VarSymbol *> &assigned,
+                              std::vector<Symbol::VarSymbol *> bound){
+    if (node->GetNodeType() == vcalc::VCalcParser::DIV){
+        return false;
+    }
+    if (node->GetNodeType() == vcalc::VCalcParser::EXPR && node->GetChildren().size() == 1 &&
+        node->GetChildren()[0]->GetNodeType() == vcalc::VCalcParser::ID){
+        auto variable = std::dynamic_pointer_cast<Symbol::VarSymbol>(node->GetChildren()[0]->GetReference());
+        if (!variable){
+            return false;
+        }
+        if (std::find(bound.begin(), bound.end(), variable.get()) != bound.end()){
+            return true;
+        }
+        // variables declared inside the loop have no value yet
+        return variable->GetValue() && std::find(assigned.begin(), assigned.end(), variable.get()) == assigned.end();
+    }
+    if (node->GetNodeType() == vcalc::VCalcParser::EXPR && node->GetChildren().size() == 3){
+        size_t op = node->GetChildren()[1]->GetNodeType();
+        if (op == vcalc::VCalcParser::GENERATOR || op == vcalc::VCalcParser::FILTER){
+            auto iterator_sym = node->GetChildren()[1]->GetChildren()[0]->GetReference();
+            bound.push_back(static_cast<Symbol::VarSymbol *>(iterator_sym.get()));
+        }
+    }
+    for (const auto &child : node->GetChildren()){
+        if (!IsLoopInvariant(child, assigned, bound)){
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<mlir::Value> CodeGen::GetValues(const std::vector<Symbol::VarSymbol *> &variables){
+    std::vector<mlir::Value> values;
+    for (Symbol::VarSymbol *variable : variables){
+        values.push_back(variable->GetValue());
+    }
+    return values;
+}
+
+void CodeGen::BindBlockArguments(mlir::Block *block, const std::vector<Symbol::VarSymbol *> &variables){
+    for (Symbol::VarSymbol *variable : variables){
+        variable->SetValue(block->addArgument(int_type, loc));
+    }
+}
+
+bool CodeGen::IsOwnedVector(Ast::Node node){
+    if (node->GetNodeType() != vcalc::VCalcParser::EXPR || hoisted.count(node)){
+        return false;
+    }
+    auto type_sym = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(node->GetReference());
+    if (!type_sym->IsType(Type::VECTOR)){
+        return false;
+    }
+    if (node->GetChildren().size() == 1){ // (expr) passes its value through, ID is borrowed
+        return IsOwnedVector(node->GetChildren()[0]);
+    }
+    // ranges, indexing by a vector, element-wise ops, generators and filters all allocate their result
+    return true;
+}
+
+void CodeGen::FreeIfOwned(Ast::Node node, mlir::Value value){
+    if (IsOwnedVector(node)){
+        FreeVector(value);
+    }
+}
+
+bool CodeGen::SameLength(Ast::Node left, Ast::Node right){
+    return left->GetLengthClass() != 0 && left->GetLengthClass() == right->GetLengthClass();
+}
+
+bool CodeGen::IsRange(Ast::Node node){
+    return node->GetNodeType() == vcalc::VCalcParser::EXPR && node->GetChildren().size() == 3 && !hoisted.count(node) &&
+           node->GetChildren()[1]->GetNodeType() == vcalc::VCalcParser::DOTS;
+}
+
+CodeGen::VectorView CodeGen::GenerateVectorView(Ast::Node node){
+    VectorView view;
+    if (IsRange(node)){
+        Visit(node->GetChildren()[0]);
+        Visit(node->GetChildren()[2]);
+        mlir::Value upper = opperands.top();
+        opperands.pop();
+        view.lower = opperands.top();
+        opperands.pop();
+        if (node->GetLength() >= 0){
+            view.size = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, node->GetLength());
+        }
+        else{
+            // same size as vector_range, empty when the bounds are reversed
+            mlir::Value empty = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::slt, upper, view.lower);
+            mlir::Value dif = builder->create<mlir::LLVM::SubOp>(loc, upper, view.lower);
+            mlir::Value count = builder->create<mlir::LLVM::AddOp>(loc, dif, const_one);
+            view.size = builder->create<mlir::LLVM::SelectOp>(loc, empty, const_zero, count);
+        }
+        return view;
+    }
+    Visit(node);
+    view.vector = opperands.top();
+    opperands.pop();
+    mlir::Value size_addr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, view.vector, mlir::ValueRange{const_zero});
+    view.size = builder->create<mlir::LLVM::LoadOp>(loc, int_type, size_addr);
+    view.data = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, view.vector, mlir::ValueRange{const_one});
+    return view;
+}
+
+mlir::Value CodeGen::GenerateViewElement(const VectorView &view, mlir::Value index){
+    if (!view.data){
+        return builder->create<mlir::LLVM::AddOp>(loc, view.lower, index);
+    }
+    mlir::Value element_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, view.data, mlir::ValueRange{index});
+    return builder->create<mlir::LLVM::LoadOp>(loc, int_type, element_ptr);
+}
+
+mlir::Value CodeGen::GenerateCheckedViewElement(const VectorView &view, mlir::Value index){
+    if (view.vector){
+        mlir::LLVM::LLVMFuncOp index_func = GetHelper("vector_index");
+        return builder->create<mlir::LLVM::CallOp>(loc, index_func, mlir::ValueRange{view.vector, index}).getResult();
+    }
+    mlir::Value above_lower = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::sge, index, const_zero);
+    mlir::Value below_upper = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::slt, index, view.size);
+    mlir::Value in_bounds = builder->create<mlir::LLVM::AndOp>(loc, above_lower, below_upper);
+    mlir::Value element = builder->create<mlir::LLVM::AddOp>(loc, view.lower, index);
+    return builder->create<mlir::LLVM::SelectOp>(loc, in_bounds, element, const_zero);
+}
+
+mlir::Value CodeGen::GenerateLazyIndex(Ast::Node node){
+    Ast::Node left = node->GetChildren()[0];
+    Ast::Node right = node->GetChildren()[2];
+    VectorView domain = GenerateVectorView(left);
+    mlir::Value result;
+    auto r_opperand_sym = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(right->GetReference());
+    if (r_opperand_sym->IsType(Type::INT)){
+        Visit(right);
+        mlir::Value index = opperands.top();
+        opperands.pop();
+        result = GenerateCheckedViewElement(domain, index);
+    }
+    else{
+        // one element per index, same as vector_index_vector
+        VectorView indices = GenerateVectorView(right);
+        result = GenerateVectorTypePtr(indices.size);
+        mlir::Value result_arr_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, result, mlir::ValueRange{const_one});
+        mlir::scf::ForOp for_loop = builder->create<mlir::scf::ForOp>(loc, const_zero, indices.size, const_one);
+        mlir::Value loop_index = for_loop.getInductionVar();
+        mlir::OpBuilder::InsertPoint save = builder->saveInsertionPoint();
+        builder->setInsertionPointToStart(for_loop.getBody());
+        mlir::Value index = GenerateViewElement(indices, loop_index);
+        mlir::Value element = GenerateCheckedViewElement(domain, index);
+        mlir::Value arr_index_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, result_arr_ptr, mlir::ValueRange{loop_index});
+        builder->create<mlir::LLVM::StoreOp>(loc, element, arr_index_ptr);
+        builder->restoreInsertionPoint(save);
+        if (indices.vector){
+            FreeIfOwned(right, indices.vector);
+        }
+    }
+    if (domain.vector){
+        FreeIfOwned(left, domain.vector);
+    }
+    return result;
+}
+
+bool CodeGen::IsElementWise(Ast::Node node){
+    // a hoisted op is already computed and becomes a leaf of the tree around it
+    if (node->GetNodeType() != vcalc::VCalcParser::EXPR || node->GetChildren().size() != 3 || hoisted.count(node)){
+        return false;
+    }
+    size_t op = node->GetChildren()[1]->GetNodeType();
+    bool arithmetic = op == vcalc::VCalcParser::ADD || op == vcalc::VCalcParser::SUB ||
+                      op == vcalc::VCalcParser::MUL || op == vcalc::VCalcParser::DIV;
+    if (!arithmetic && !IsIntBoolOperation(op)){
+        return false;
+    }
+    auto type_sym = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(node->GetReference());
+    return type_sym->IsType(Type::VECTOR);
+}
+
+size_t CodeGen::CountElementWise(Ast::Node node){
+    if (!IsElementWise(node)){
+        return 0;
+    }
+    return 1 + CountElementWise(node->GetChildren()[0]) + CountElementWise(node->GetChildren()[2]);
+}
+
+void CodeGen::CollectFusedLeaves(Ast::Node node, FusedTree &tree){
+    if (IsElementWise(node)){
+        Ast::Node left = node->GetChildren()[0];
+        Ast::Node right = node->GetChildren()[2];
+        CollectFusedLeaves(left, tree);
+        CollectFusedLeaves(right, tree);
+
+        // an element-wise op is as long as its longest vector operand, ints take the other side's size
+        auto l_size = tree.sizes.find(left);
+        auto r_size = tree.sizes.find(right);
+        if (l_size == tree.sizes.end()){
+            tree.sizes[node] = r_size->second;
+        }
+        else if (r_size == tree.sizes.end()){
+            tree.sizes[node] = l_size->second;
+        }
+        else{
+            mlir::Value left_larger = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::sgt, l_size->second, r_size->second);
+            tree.sizes[node] = builder->create<mlir::LLVM::SelectOp>(loc, left_larger, l_size->second, r_size->second);
+        }
+        return;
+    }
+
+    FusedTree::Leaf leaf;
+    auto type_sym = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(node->GetReference());
+    if (type_sym->IsType(Type::VECTOR)){
+        // a range leaf stays lazy, its elements are computed from the lower bound in the loop
+        leaf.view = GenerateVectorView(node);
+        leaf.value = leaf.view.vector;
+        leaf.owned = leaf.view.vector && IsOwnedVector(node);
+        tree.sizes[node] = leaf.view.size;
+    }
+    else{
+        Visit(node);
+        leaf.value = opperands.top();
+        opperands.pop();
+    }
+    tree.leaves[node] = leaf;
+}
+
+mlir::Value CodeGen::GenerateFusedElement(FusedTree &tree, Ast::Node node, mlir::Value index, bool guarded, int padding_value){
+    auto leaf = tree.leaves.find(node);
+    if (leaf != tree.leaves.end()){
+        if (!leaf->second.view.size){ // ints are broadcast in register
+            return leaf->second.value;
+        }
+        if (!guarded){
+            return GenerateViewElement(leaf->second.view, index);
+        }
+        // a shorter operand reads as padding past its end, same as match_vector_size
+        mlir::Value in_bounds = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::slt, index, leaf->second.view.size);
+        mlir::scf::IfOp if_in_bounds = builder->create<mlir::scf::IfOp>(loc, mlir::TypeRange{int_type}, in_bounds, true);
+        mlir::OpBuilder::InsertPoint save = builder->saveInsertionPoint();
+        builder->setInsertionPointToStart(&if_in_bounds.getThenRegion().front());
+        mlir::Value element = GenerateViewElement(leaf->second.view, index);
+        builder->create<mlir::scf::YieldOp>(loc, element);
+        builder->setInsertionPointToStart(&if_in_bounds.getElseRegion().front());
+        mlir::Value padding = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, padding_value);
+        builder->create<mlir::scf::YieldOp>(loc, padding);
+        builder->restoreInsertionPoint(save);
+        return if_in_bounds.getResult(0);
+    }
+
+    size_t op = node->GetChildren()[1]->GetNodeType();
+    // the rhs of a division is padded with ones so padding never divides by zero
+    mlir::Value lhs = GenerateFusedElement(tree, node->GetChildren()[0], index, guarded, 0);
+    mlir::Value rhs = GenerateFusedElement(tree, node->GetChildren()[2], index, guarded, op == vcalc::VCalcParser::DIV ? 1 : 0);
+    mlir::Value value = CreateIntOperation(op, lhs, rhs);
+    if (guarded && node != tree.root){
+        mlir::Value in_bounds = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::slt, index, tree.sizes[node]);
+        mlir::Value padding = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, padding_value);
+        value = builder->create<mlir::LLVM::SelectOp>(loc, in_bounds, value, padding);
+    }
+    return value;
+}
+
+void CodeGen::GenerateFusedLoop(FusedTree &tree, Ast::Node node, mlir::Value result_arr_ptr, mlir::Value size, bool guarded){
+    mlir::scf::ForOp for_loop = builder->create<mlir::scf::ForOp>(loc, const_zero, size, const_one);
+    mlir::Value loop_index = for_loop.getInductionVar();
+    mlir::OpBuilder::InsertPoint save = builder->saveInsertionPoint();
+    builder->setInsertionPointToStart(for_loop.getBody());
+
+    mlir::Value element = GenerateFusedElement(tree, node, loop_index, guarded, 0);
+    mlir::Value arr_index_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, result_arr_ptr, mlir::ValueRange{loop_index});
+    builder->create<mlir::LLVM::StoreOp>(loc, element, arr_index_ptr);
+
+    builder->restoreInsertionPoint(save);
+}
+
+mlir::Value CodeGen::GenerateFusedExpr(Ast::Node node){
+    FusedTree tree;
+    tree.root = node;
+    CollectFusedLeaves(node, tree);
+
+    // only the final result is allocated, intermediate ops live in registers
+    mlir::Value size = tree.sizes[node];
+    if (node->GetLength() >= 0){
+        size = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, node->GetLength());
+    }
+    mlir::Value result = GenerateVectorTypePtr(size);
+    mlir::Value result_arr_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, result, mlir::ValueRange{const_one});
+
+    // length inference proved every vector operand has the result length, nothing can need padding
+    bool same_length = node->GetLengthClass() != 0;
+    for (const auto &leaf : tree.leaves){
+        if (leaf.second.view.size && leaf.first->GetLengthClass() != node->GetLengthClass()){
+            same_length = false;
+        }
+    }
+    if (same_length){
+        GenerateFusedLoop(tree, node, result_arr_ptr, size, false);
+    }
+    else{
+        // when every vector operand already has the result size at runtime nothing needs padding either
+        mlir::Value same_size;
+        for (const auto &leaf : tree.leaves){
+            if (!leaf.second.view.size){
+                continue;
+            }
+            mlir::Value equal = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::eq, leaf.second.view.size, size);
+            if (same_size){
+                same_size = builder->create<mlir::LLVM::AndOp>(loc, same_size, equal);
+            }
+            else{
+                same_size = equal;
+            }
+        }
+
+        mlir::scf::IfOp size_check = builder->create<mlir::scf::IfOp>(loc, same_size, true);
+        mlir::OpBuilder::InsertPoint save = builder->saveInsertionPoint();
+        builder->setInsertionPointToStart(&size_check.getThenRegion().front());
+        GenerateFusedLoop(tree, node, result_arr_ptr, size, false);
+        builder->setInsertionPointToStart(&size_check.getElseRegion().front());
+        GenerateFusedLoop(tree, node, result_arr_ptr, size, true);
+        builder->restoreInsertionPoint(save);
+    }
+
+    for (const auto &leaf : tree.leaves){
+        if (leaf.second.owned){
+            FreeVector(leaf.second.value);
+        }
+    }
+
+    return result;
+}
+
+void CodeGen::VisitPRINT(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT PRINT\n";
     }
@@ -744,40 +1679,36 @@ void CodeGen::VisitPRINT(std::shared_ptr<Ast::AstNode> current_node){
     opperands.pop();
     auto type_sym = std::static_pointer_cast<Symbol::BuiltInTypeSymbol>(current_node->GetChildren()[0]->GetReference());
     if (type_sym->IsType(Type::INT)){
-        mlir::LLVM::LLVMFuncOp printf_function = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("printf");
-        mlir::LLVM::GlobalOp int_format = module.lookupSymbol<mlir::LLVM::GlobalOp>("int_new_line_format");
-        mlir::Value int_format_ptr = builder->create<mlir::LLVM::AddressOfOp>(loc, int_format); 
-        mlir::ValueRange args = {int_format_ptr, result};
-        builder->create<mlir::LLVM::CallOp>(loc, printf_function, args);
+        mlir::LLVM::LLVMFuncOp print_function = GetHelper("print_int");
+        mlir::ValueRange args = {result};
+        builder->create<mlir::LLVM::CallOp>(loc, print_function, args);
     }
     else if (type_sym->IsType(Type::VECTOR)){
-        mlir::LLVM::LLVMFuncOp printf_function = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("print_vector");
+        mlir::LLVM::LLVMFuncOp printf_function = GetHelper("print_vector");
         mlir::ValueRange args = {result};
         builder->create<mlir::LLVM::CallOp>(loc, printf_function, args);
+        FreeIfOwned(current_node->GetChildren()[0], result);
         
     } 
     else{
-        std::cout << "ERROR IN PRINT\n";
-        throw -1;
+        throw std::runtime_error("Unsupported print type at line " + std::to_string(current_node->GetLine()));
     }
     if (program_flags & DEBUG){
         std::cout << "OUT PRINT\n";
     }
 }
 
-void CodeGen::VisitID(std::shared_ptr<Ast::AstNode> current_node){
+void CodeGen::VisitID(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT ID\n";
     }
-    std::string var_name = current_node->GetText();
-    auto var_symb = std::static_pointer_cast<Symbol::VarSymbol>(current_scope->Resolve(var_name));
-    mlir::Value value_ptr = var_symb->GetValue();
+    auto var_symb = std::static_pointer_cast<Symbol::VarSymbol>(current_node->GetReference());
     mlir::Value value;
-    if (var_symb->GetTypeSymbol()->IsType(Type::INT)){
-        value = builder->create<mlir::LLVM::LoadOp>(loc, int_type, value_ptr);
+    if (var_symb->GetTypeSymbol()->IsType(Type::INT)){ // the current SSA value of the int
+        value = var_symb->GetValue();
     }
     else if (var_symb->GetTypeSymbol()->IsType(Type::VECTOR)){
-        value = builder->create<mlir::LLVM::LoadOp>(loc, ptr_type, value_ptr);
+        value = builder->create<mlir::LLVM::LoadOp>(loc, ptr_type, var_symb->GetValue());
     }
 
     opperands.push(value);
@@ -786,7 +1717,7 @@ void CodeGen::VisitID(std::shared_ptr<Ast::AstNode> current_node){
     }
 }
 
-void CodeGen::VisitINT(std::shared_ptr<Ast::AstNode> current_node){
+void CodeGen::VisitINT(Ast::Node current_node){
     if (program_flags & DEBUG){
         std::cout << "AT INT\n";
     }
@@ -800,25 +1731,25 @@ void CodeGen::VisitINT(std::shared_ptr<Ast::AstNode> current_node){
 }
 
 // Astprogram_flags & DEBUGger Visitor methods
-void AstDebugger::DfsTraversal(std::shared_ptr<Ast::AstNode> current_node){
+void AstDebugger::DfsTraversal(Ast::Node current_node){
     std::cout << "This is the depth first search traversal of the AST:\n";
     Visit(current_node);
     std::cout << std::endl;
 }
 
-void AstDebugger::VisitBLOCK(std::shared_ptr<Ast::AstNode> current_node){
+void AstDebugger::VisitBLOCK(Ast::Node current_node){
     std::cout << "At BLOCK\n";
     VisitChildren(current_node);
 }
-void AstDebugger::VisitIF_BLOCK(std::shared_ptr<Ast::AstNode> current_node){
+void AstDebugger::VisitIF_BLOCK(Ast::Node current_node){
     std::cout << "At IF_BLOCK\n";
     VisitChildren(current_node);
 }
-void AstDebugger::VisitLOOP_BLOCK(std::shared_ptr<Ast::AstNode> current_node){
+void AstDebugger::VisitLOOP_BLOCK(Ast::Node current_node){
     std::cout << "At LOOP_BLOCK\n";
     VisitChildren(current_node);
 }
-void AstDebugger::VisitDECL(std::shared_ptr<Ast::AstNode> current_node){
+void AstDebugger::VisitDECL(Ast::Node current_node){
     std::cout << "At DECL\n";
     if (current_node->GetChildren()[0]->GetNodeType() == vcalc::VCalcParser::TYPE){
         std::cout << "AT TYPE\n";
@@ -829,12 +1760,12 @@ void AstDebugger::VisitDECL(std::shared_ptr<Ast::AstNode> current_node){
     }
     VisitChildren(current_node);
 }
-void AstDebugger::VisitASSIGN(std::shared_ptr<Ast::AstNode> current_node){
+void AstDebugger::VisitASSIGN(Ast::Node current_node){
     std::cout << "At ASSIGN\n";
     VisitChildren(current_node);
 }
-void AstDebugger::ExprPrintOp(std::shared_ptr<Ast::AstNode> current_node){
-    std::shared_ptr<Ast::AstNode> oper_node(current_node->GetChildren()[1]);
+void AstDebugger::ExprPrintOp(Ast::Node current_node){
+    Ast::Node oper_node(current_node->GetChildren()[1]);
     switch (oper_node->GetNodeType()){
         case (vcalc::VCalcParser::ADD):
             std::cout << "At ADD\n";
@@ -879,7 +1810,7 @@ void AstDebugger::ExprPrintOp(std::shared_ptr<Ast::AstNode> current_node){
             exit(-1);
     }
 }
-void AstDebugger::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
+void AstDebugger::VisitEXPR(Ast::Node current_node){
     std::cout << "At EXPR\n";
     if (current_node->GetChildren().size() == 1){
         VisitChildren(current_node);
@@ -890,15 +1821,15 @@ void AstDebugger::VisitEXPR(std::shared_ptr<Ast::AstNode> current_node){
         Visit(current_node->GetChildren()[2]);
     }
 }
-void AstDebugger::VisitPRINT(std::shared_ptr<Ast::AstNode> current_node){
+void AstDebugger::VisitPRINT(Ast::Node current_node){
     std::cout << "At PRINT\n";
     VisitChildren(current_node);
 }
-void AstDebugger::VisitID(std::shared_ptr<Ast::AstNode> current_node){
+void AstDebugger::VisitID(Ast::Node current_node){
     std::cout << "At ID\n";
     VisitChildren(current_node);
 }
-void AstDebugger::VisitINT(std::shared_ptr<Ast::AstNode> current_node){
+void AstDebugger::VisitINT(Ast::Node current_node){
     std::cout << "At INT\n";
     VisitChildren(current_node);
 }
@@ -4,7 +4,8 @@
 #include "VCalcParser.h"
 #include "Type.h"
 
-BackEnd::BackEnd() : loc(mlir::UnknownLoc::get(&context)) {
+BackEnd::BackEnd(const std::string &prelude_path, bool reusable)
+    : loc(mlir::UnknownLoc::get(&context)), prelude_path(prelude_path) {
     // Load Dialects.
     context.loadDialect<mlir::LLVM::LLVMDialect>();
     context.loadDialect<mlir::arith::ArithDialect>();
@@ -29,41 +30,159 @@ BackEnd::BackEnd() : loc(mlir::UnknownLoc::get(&context)) {
 
     // Some intial setup to get off the ground 
     setupPrintf();
-    DeclarePrintIntSpace();
-
-    /// Int Arithmetic
-    CreateIntArithmeticOperation(vcalc::VCalcParser::ADD);
-    CreateIntArithmeticOperation(vcalc::VCalcParser::SUB);
-    CreateIntArithmeticOperation(vcalc::VCalcParser::MUL);
-    CreateIntArithmeticOperation(vcalc::VCalcParser::DIV);
-
-    /// Int Bool
-    CreateIntBooleanOperation(vcalc::VCalcParser::LESS);
-    CreateIntBooleanOperation(vcalc::VCalcParser::GREATER);
-    CreateIntBooleanOperation(vcalc::VCalcParser::LOGEQ);
-    CreateIntBooleanOperation(vcalc::VCalcParser::LOGNEQ);
-    CreateCastBoolToInt();
-
-    /// Vector Misc
-    CreateIntToVectorFunction();
-    CreatePrintVectorOperation();
-    CreateVectorRangeOperation();
-    CreateVectorIndexOperation();
-    CreateVectorIndexVectorOperation();
-
-    /// Vector Operations
-    CreateConditionalSetVectorFunc();
-    CreateVectorSizePromotionFunction();
-    CreateVectorMatchSizeFunction();
-
-    CreateVectorOperationFunction(vcalc::VCalcParser::ADD);
-    CreateVectorOperationFunction(vcalc::VCalcParser::SUB);
-    CreateVectorOperationFunction(vcalc::VCalcParser::MUL);
-    CreateVectorOperationFunction(vcalc::VCalcParser::DIV);
-    CreateVectorOperationFunction(vcalc::VCalcParser::LESS);
-    CreateVectorOperationFunction(vcalc::VCalcParser::GREATER);
-    CreateVectorOperationFunction(vcalc::VCalcParser::LOGEQ);
-    CreateVectorOperationFunction(vcalc::VCalcParser::LOGNEQ);
+
+    // Helpers are only emitted once codegen asks for them, see GetHelper. They are declared from the prelude when
+    // there is one and built as MLIR otherwise.
+    RegisterHelpers();
+    if (!this->prelude_path.empty() && ReadPrelude(this->prelude_path)) {
+        this->prelude_path.clear();
+    }
+
+    if (reusable) {
+        helper_module = module.clone();
+        // Reusable backends are run side by side on their own threads, the pass manager does not need more
+        context.disableMultithreading();
+    }
+}
+
+void BackEnd::RegisterHelpers() {
+    /// Misc
+    helper_builders["cond_print_space"] = [this]() { DeclarePrintIntSpace(); };
+    helper_builders["int_to_vector"] = [this]() { CreateIntToVectorFunction(); };
+    helper_builders["print_vector"] = [this]() { CreatePrintVectorOperation(); };
+    helper_builders["print_int"] = [this]() { CreatePrintIntOperation(); };
+    helper_builders["vector_range"] = [this]() { CreateVectorRangeOperation(); };
+    helper_builders["vector_index"] = [this]() { CreateVectorIndexOperation(); };
+    helper_builders["vector_index_vector"] = [this]() { CreateVectorIndexVectorOperation(); };
+
+    /// Vector size handling
+    helper_builders["cond_copy_arr"] = [this]() { CreateConditionalSetVectorFunc(); };
+    helper_builders["increase_vector_size"] = [this]() { CreateVectorSizePromotionFunction(); };
+    helper_builders["match_vector_size"] = [this]() { CreateVectorMatchSizeFunction(); };
+    helper_builders["vector_copy"] = [this]() { CreateVectorCopyFunction(); };
+
+    /// Vector, same size and vector scalar operations
+    for (size_t op : {vcalc::VCalcParser::ADD, vcalc::VCalcParser::SUB, vcalc::VCalcParser::MUL, vcalc::VCalcParser::DIV,
+                      vcalc::VCalcParser::LESS, vcalc::VCalcParser::GREATER, vcalc::VCalcParser::LOGEQ, vcalc::VCalcParser::LOGNEQ}) {
+        std::string vector_func = GetOperationFunc(op, Type::VCalcTypes::VECTOR);
+        helper_builders[vector_func] = [this, op]() { CreateVectorOperationFunction(op, false); };
+        helper_builders[vector_func + "_unchecked"] = [this, op]() { CreateVectorOperationFunction(op, true); };
+        helper_builders[GetScalarOperationFunc(op, false)] = [this, op]() { CreateVectorScalarOperationFunction(op, false); };
+        helper_builders[GetScalarOperationFunc(op, true)] = [this, op]() { CreateVectorScalarOperationFunction(op, true); };
+    }
+}
+
+mlir::LLVM::LLVMFuncOp BackEnd::GetHelper(const std::string &name) {
+    if (auto func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>(name)) {
+        return func;
+    }
+    // Helpers are emitted at the start of the module whatever codegen was in the middle of
+    mlir::OpBuilder::InsertionGuard guard(*builder);
+    builder->setInsertionPointToStart(module.getBody());
+    auto signature = prelude_signatures.find(name);
+    if (signature != prelude_signatures.end()) {
+        return builder->create<mlir::LLVM::LLVMFuncOp>(loc, name, signature->second);
+    }
+    auto helper = helper_builders.find(name);
+    if (helper == helper_builders.end()) {
+        throw std::runtime_error("Unknown helper function " + name);
+    }
+    helper->second();
+    return module.lookupSymbol<mlir::LLVM::LLVMFuncOp>(name);
+}
+
+void BackEnd::EraseUnusedHelpers() {
+    // Erasing a helper can leave the helpers only it called unused, repeat until nothing changes
+    bool erased = true;
+    while (erased) {
+        erased = false;
+        for (auto func : llvm::make_early_inc_range(module.getOps<mlir::LLVM::LLVMFuncOp>())) {
+            std::string name = func.getName().str();
+            bool is_helper = helper_builders.count(name) || prelude_signatures.count(name);
+            if (is_helper && mlir::SymbolTable::symbolKnownUseEmpty(func, module)) {
+                func.erase();
+                erased = true;
+            }
+        }
+    }
+}
+
+int BackEnd::ReadPrelude(const std::string &path) {
+    // Loaded lazily, only the function signatures are read
+    llvm::SMDiagnostic error;
+    std::unique_ptr<llvm::Module> prelude = llvm::getLazyIRFileModule(path, error, llvm_context);
+    if (!prelude) {
+        error.print("vcalc", llvm::errs());
+        return 1;
+    }
+    mlir::LLVM::TypeFromLLVMIRTranslator type_translator(context);
+    for (llvm::Function &function : *prelude) {
+        if (function.isDeclaration() || function.hasLocalLinkage()) {
+            continue;
+        }
+        prelude_signatures[function.getName().str()] =
+            llvm::cast<mlir::LLVM::LLVMFunctionType>(type_translator.translateType(function.getFunctionType()));
+    }
+    return 0;
+}
+
+int BackEnd::LinkPrelude(llvm::Module &target) {
+    // A declaration makes LinkOnlyNeeded link the helper, drop the ones nothing calls
+    for (llvm::Function &function : llvm::make_early_inc_range(target)) {
+        if (function.isDeclaration() && function.use_empty()) {
+            function.eraseFromParent();
+        }
+    }
+    llvm::SMDiagnostic error;
+    std::unique_ptr<llvm::Module> prelude = llvm::getLazyIRFileModule(prelude_path, error, target.getContext());
+    if (!prelude) {
+        error.print("vcalc", llvm::errs());
+        return 1;
+    }
+    // Linked helpers become internal so the optimizer can inline them and drop what it no longer needs, just like
+    // helpers built into the module
+    bool failed = llvm::Linker::linkModules(target, std::move(prelude), llvm::Linker::Flags::LinkOnlyNeeded,
+        [](llvm::Module &linked_module, const llvm::StringSet<> &linked_names) {
+            llvm::internalizeModule(linked_module, [&linked_names](const llvm::GlobalValue &value) {
+                return !value.hasName() || !linked_names.count(value.getName());
+            });
+        });
+    if (failed) {
+        llvm::errs() << "Failed to link the prelude " << prelude_path << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+int BackEnd::emitPrelude(const std::string &path) {
+    if (!prelude_path.empty()) {
+        llvm::errs() << "The prelude can only be emitted by a BackEnd that builds the helpers\n";
+        return 1;
+    }
+    for (const auto &helper : helper_builders) {
+        GetHelper(helper.first);
+    }
+    if (lowerDialects() || translateToLLVM()) {
+        return 1;
+    }
+    std::error_code error;
+    llvm::raw_fd_ostream output(path, error, llvm::sys::fs::OF_None);
+    if (error) {
+        llvm::errs() << "Could not open " << path << ": " << error.message() << "\n";
+        return 1;
+    }
+    llvm::WriteBitcodeToFile(*llvm_module, output);
+    return 0;
+}
+
+void BackEnd::Reset() {
+    assert(helper_module && "Reset needs a reusable BackEnd");
+    module.erase();
+    module = helper_module.clone();
+    builder->setInsertionPointToStart(module.getBody());
+    main_func = nullptr;
+    // The next program is translated from scratch
+    llvm_module.reset();
 }
 
 int BackEnd::emitModule() {
@@ -108,12 +227,178 @@ int BackEnd::lowerDialects() {
     return 0;
 }
 
-void BackEnd::dumpLLVM(std::ostream &os) {  
+int BackEnd::translateToLLVM() {
     // The only remaining dialects in our module after the passes are builtin
     // and LLVM. Setup translation patterns to get them to LLVM IR.
     mlir::registerBuiltinDialectTranslation(context);
     mlir::registerLLVMDialectTranslation(context);
     llvm_module = mlir::translateModuleToLLVMIR(module, llvm_context);
+    if (!llvm_module) {
+        llvm::errs() << "Failed to translate module to LLVM IR\n";
+        return 1;
+    }
+    if (!prelude_path.empty() && LinkPrelude(*llvm_module)) {
+        return 1;
+    }
+    return 0;
+}
+
+int BackEnd::CreateTargetMachine() {
+    if (target_machine) {
+        return 0;
+    }
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    std::string triple = llvm::sys::getDefaultTargetTriple();
+    std::string error;
+    const llvm::Target *target = llvm::TargetRegistry::lookupTarget(triple, error);
+    if (!target) {
+        llvm::errs() << "Failed to find target for " << triple << ": " << error << "\n";
+        return 1;
+    }
+    llvm::TargetOptions options;
+    target_machine.reset(target->createTargetMachine(triple, target_cpu, target_features, options, llvm::Reloc::PIC_));
+    return target_machine ? 0 : 1;
+}
+
+void BackEnd::UseHostCPU() {
+    target_cpu = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> host_features;
+    target_features.clear();
+    if (!llvm::sys::getHostCPUFeatures(host_features)) {
+        return;
+    }
+    for (const auto &feature : host_features) {
+        if (!target_features.empty()) {
+            target_features += ",";
+        }
+        target_features += (feature.getValue() ? "+" : "-") + feature.getKey().str();
+    }
+}
+
+int BackEnd::emitObject(const std::string &path) {
+    if (!llvm_module && translateToLLVM()) {
+        return 1;
+    }
+    if (CreateTargetMachine()) {
+        return 1;
+    }
+    llvm_module->setTargetTriple(target_machine->getTargetTriple().str());
+    llvm_module->setDataLayout(target_machine->createDataLayout());
+
+    std::error_code error;
+    llvm::raw_fd_ostream output(path, error, llvm::sys::fs::OF_None);
+    if (error) {
+        llvm::errs() << "Could not open " << path << ": " << error.message() << "\n";
+        return 1;
+    }
+    llvm::legacy::PassManager pass_manager;
+    if (target_machine->addPassesToEmitFile(pass_manager, output, nullptr, llvm::CGFT_ObjectFile)) {
+        llvm::errs() << "The target cannot emit object files\n";
+        return 1;
+    }
+    pass_manager.run(*llvm_module);
+    output.flush();
+    return 0;
+}
+
+int BackEnd::optimizeLLVM(unsigned int opt_level) {
+    if (!llvm_module && translateToLLVM()) {
+        return 1;
+    }
+    if (opt_level == 0) {
+        return 0;
+    }
+    if (CreateTargetMachine()) {
+        return 1;
+    }
+    // Give the optimizer the real data layout so the vectorizers get target info
+    llvm_module->setTargetTriple(target_machine->getTargetTriple().str());
+    llvm_module->setDataLayout(target_machine->createDataLayout());
+
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    llvm::PassBuilder pass_builder(target_machine.get());
+    pass_builder.registerModuleAnalyses(mam);
+    pass_builder.registerCGSCCAnalyses(cgam);
+    pass_builder.registerFunctionAnalyses(fam);
+    pass_builder.registerLoopAnalyses(lam);
+    pass_builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+    llvm::OptimizationLevel level;
+    switch (opt_level) {
+        case 1:
+            level = llvm::OptimizationLevel::O1;
+            break;
+        case 2:
+            level = llvm::OptimizationLevel::O2;
+            break;
+        default:
+            level = llvm::OptimizationLevel::O3;
+            break;
+    }
+    llvm::ModulePassManager mpm = pass_builder.buildPerModuleDefaultPipeline(level);
+    mpm.run(*llvm_module, mam);
+    return 0;
+}
+
+int BackEnd::runJIT(unsigned int opt_level, const std::string &runtime_path) {
+    if (CreateTargetMachine()) {
+        return 1;
+    }
+    mlir::registerBuiltinDialectTranslation(context);
+    mlir::registerLLVMDialectTranslation(context);
+
+    mlir::ExecutionEngineOptions options;
+    options.transformer = mlir::makeOptimizingTransformer(opt_level, 0, target_machine.get());
+    options.jitCodeGenOptLevel = static_cast<llvm::CodeGenOpt::Level>(opt_level);
+    // The extern_weak vcalcrt declarations resolve against the library once it is loaded into the process
+    std::vector<llvm::StringRef> shared_libs;
+    if (!runtime_path.empty()) {
+        shared_libs.push_back(runtime_path);
+    }
+    options.sharedLibPaths = shared_libs;
+    // Let perf and gdb see the JIT-ed functions
+    options.enableGDBNotificationListener = true;
+    options.enablePerfNotificationListener = true;
+
+    // The JIT translates the module itself, the prelude helpers are linked in right after
+    auto build_llvm_module = [this](mlir::Operation *op, llvm::LLVMContext &jit_context) -> std::unique_ptr<llvm::Module> {
+        std::unique_ptr<llvm::Module> jit_module = mlir::translateModuleToLLVMIR(op, jit_context);
+        if (!jit_module || LinkPrelude(*jit_module)) {
+            return nullptr;
+        }
+        return jit_module;
+    };
+    if (!prelude_path.empty()) {
+        options.llvmModuleBuilder = build_llvm_module;
+    }
+
+    auto engine = mlir::ExecutionEngine::create(module, options);
+    if (!engine) {
+        llvm::errs() << "Failed to create the JIT: " << llvm::toString(engine.takeError()) << "\n";
+        return 1;
+    }
+    auto main_addr = (*engine)->lookup("main");
+    if (!main_addr) {
+        llvm::errs() << "Failed to find main in the JIT: " << llvm::toString(main_addr.takeError()) << "\n";
+        return 1;
+    }
+    auto jit_main = reinterpret_cast<int (*)()>(*main_addr);
+    int result = jit_main();
+    // The printf fallback writes through this process' stdio
+    fflush(stdout);
+    return result;
+}
+
+void BackEnd::dumpLLVM(std::ostream &os) {  
+    if (!llvm_module && translateToLLVM()) {
+        return;
+    }
 
     // Create llvm ostream and dump into the output file
     llvm::raw_os_ostream output(os);
@@ -222,34 +507,6 @@ void BackEnd::createGlobalString(const char *str, const char *stringName) {
                             mlir::LLVM::Linkage::Internal, stringName,
                             builder->getStringAttr(mlirString), /*alignment=*/0);
 }
-void BackEnd::CreateCastBoolToInt(){
-    mlir::Type int1_type = mlir::IntegerType::get(&context, 1);
-    auto type = mlir::LLVM::LLVMFunctionType::get(int_type, {int1_type},true);
-    std::string name = "bool_to_int";
-    auto func = builder->create<mlir::LLVM::LLVMFuncOp>(loc, name, type);
-    auto *entryBlock = func.addEntryBlock();
-
-    /// Entry Block
-    builder->setInsertionPointToStart(entryBlock);
-    mlir::Value arg0 = entryBlock->getArgument(0); // First argument
-
-    auto true_dest = func.addBlock();
-    auto false_dest = func.addBlock();
-    builder->create<mlir::LLVM::CondBrOp>(loc, arg0, true_dest, false_dest);
-
-    /// True Dest
-    builder->setInsertionPointToStart(true_dest);
-    mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
-    builder->create<mlir::LLVM::ReturnOp>(loc, one);
-
-    /// False Dest
-    builder->setInsertionPointToStart(false_dest);
-    mlir::Value zero = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 0);
-    builder->create<mlir::LLVM::ReturnOp>(loc, zero);
-
-    builder->setInsertionPointToStart(module.getBody());
-}
-
 mlir::LLVM::GlobalOp BackEnd::CreateGlobalInt(int val, const char *name) {
     return builder->create<mlir::LLVM::GlobalOp>(
         loc,
@@ -262,85 +519,51 @@ mlir::LLVM::GlobalOp BackEnd::CreateGlobalInt(int val, const char *name) {
     );
 }
 
-void BackEnd::CreateIntArithmeticOperation(size_t op) {
-    auto type = mlir::LLVM::LLVMFunctionType::get(int_type, {int_type,int_type},true);
-    std::string name = GetOperationFunc(op,Type::VCalcTypes::INT);
-    auto func = builder->create<mlir::LLVM::LLVMFuncOp>(loc, name, type);
-    auto *entryBlock = func.addEntryBlock();
-    builder->setInsertionPointToStart(entryBlock);
-
-    mlir::Value arg0 = entryBlock->getArgument(0); // First argument
-    mlir::Value arg1 = entryBlock->getArgument(1); // Second argument
-    mlir::Value result;
+mlir::Value BackEnd::CreateIntArithmetic(size_t op, mlir::Value lhs, mlir::Value rhs) {
     switch (op) {
         case vcalc::VCalcParser::ADD:
-            result = builder->create<mlir::LLVM::AddOp>(loc, arg0, arg1);
-            break;
+            return builder->create<mlir::LLVM::AddOp>(loc, lhs, rhs);
         case vcalc::VCalcParser::SUB:
-            result = builder->create<mlir::LLVM::SubOp>(loc, arg0, arg1);
-            break;
+            return builder->create<mlir::LLVM::SubOp>(loc, lhs, rhs);
         case vcalc::VCalcParser::DIV:
-            result = builder->create<mlir::LLVM::SDivOp>(loc, arg0, arg1);
-            break;
+            return builder->create<mlir::LLVM::SDivOp>(loc, lhs, rhs);
         case vcalc::VCalcParser::MUL:
-            result = builder->create<mlir::LLVM::MulOp>(loc, arg0, arg1);
-            break;
+            return builder->create<mlir::LLVM::MulOp>(loc, lhs, rhs);
         default:
-            break;
+            return nullptr;
     }
-    builder->create<mlir::LLVM::ReturnOp>(loc, result);
-    builder->setInsertionPointToStart(module.getBody());
 }
 
-void BackEnd::CreateIntBooleanOperation(size_t op) {
-    auto type = mlir::LLVM::LLVMFunctionType::get(int_type, {int_type,int_type},true);
-    std::string name = GetOperationFunc(op,Type::VCalcTypes::INT);
-    auto func = builder->create<mlir::LLVM::LLVMFuncOp>(loc, name, type);
-    auto *entryBlock = func.addEntryBlock();
-
-    /// Entry Block
-    builder->setInsertionPointToStart(entryBlock);
-    mlir::Value arg0 = entryBlock->getArgument(0); // First argument
-    mlir::Value arg1 = entryBlock->getArgument(1); // Second argument
-    mlir::Value predicate;
-
+mlir::Value BackEnd::CreateIntPredicate(size_t op, mlir::Value lhs, mlir::Value rhs) {
     switch (op) {
         case vcalc::VCalcParser::LESS:
-            predicate = builder->create<mlir::LLVM::ICmpOp>(
-                    loc, mlir::LLVM::ICmpPredicate::slt, arg0, arg1);
-            break;
+            return builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::slt, lhs, rhs);
         case vcalc::VCalcParser::GREATER:
-            predicate = builder->create<mlir::LLVM::ICmpOp>(
-                    loc, mlir::LLVM::ICmpPredicate::slt, arg1, arg0);
-            break;
+            return builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::sgt, lhs, rhs);
         case vcalc::VCalcParser::LOGEQ:
-            predicate = builder->create<mlir::LLVM::ICmpOp>(
-                    loc, mlir::LLVM::ICmpPredicate::eq, arg0, arg1);
-            break;
+            return builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::eq, lhs, rhs);
         case vcalc::VCalcParser::LOGNEQ:
-            predicate = builder->create<mlir::LLVM::ICmpOp>(
-                    loc, mlir::LLVM::ICmpPredicate::ne, arg0, arg1);
-            break;
+            return builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::ne, lhs, rhs);
         default:
-            break;
+            return nullptr;
     }
+}
 
-    auto true_dest = func.addBlock();
-    auto false_dest = func.addBlock();
-
-    builder->create<mlir::LLVM::CondBrOp>(loc, predicate, true_dest, false_dest);
-
-    /// True Dest
-    builder->setInsertionPointToStart(true_dest);
-    mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
-    builder->create<mlir::LLVM::ReturnOp>(loc, one);
-
-    /// False Dest
-    builder->setInsertionPointToStart(false_dest);
-    mlir::Value zero = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 0);
-    builder->create<mlir::LLVM::ReturnOp>(loc, zero);
+mlir::Value BackEnd::CreateIntBoolean(size_t op, mlir::Value lhs, mlir::Value rhs) {
+    mlir::Value predicate = CreateIntPredicate(op, lhs, rhs);
+    return builder->create<mlir::LLVM::ZExtOp>(loc, int_type, predicate);
+}
 
-    builder->setInsertionPointToStart(module.getBody());
+mlir::Value BackEnd::CreateIntOperation(size_t op, mlir::Value lhs, mlir::Value rhs) {
+    switch (op) {
+        case vcalc::VCalcParser::LESS:
+        case vcalc::VCalcParser::GREATER:
+        case vcalc::VCalcParser::LOGEQ:
+        case vcalc::VCalcParser::LOGNEQ:
+            return CreateIntBoolean(op, lhs, rhs);
+        default:
+            return CreateIntArithmetic(op, lhs, rhs);
+    }
 }
 
 mlir::Value BackEnd::CreateIntPointer(mlir::Value value) {
@@ -396,8 +619,11 @@ std::string BackEnd::GetOperationFunc(size_t op, size_t data_type = -1) {
     return data_name + "_" + op_name;
 }
 
-void BackEnd::CreateVectorOperationFunction(size_t op) {
+void BackEnd::CreateVectorOperationFunction(size_t op, bool unchecked) {
     std::string func_name = GetOperationFunc(op,Type::VCalcTypes::VECTOR);
+    if (unchecked) {
+        func_name += "_unchecked";
+    }
     auto type = mlir::LLVM::LLVMFunctionType::get(ptr_type, {ptr_type,ptr_type},true);
     auto func = builder->create<mlir::LLVM::LLVMFuncOp>(loc, func_name, type);
     auto *entryBlock = func.addEntryBlock();
@@ -410,24 +636,27 @@ void BackEnd::CreateVectorOperationFunction(size_t op) {
     mlir::Value arg0 = entryBlock->getArgument(0); // First argument
     mlir::Value arg1 = entryBlock->getArgument(1); // Second argument
 
-    mlir::LLVM::LLVMFuncOp check_size_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("match_vector_size");
-
-    // Increases lhs vector size if required
-    mlir::ValueRange args = {arg0,arg1,zero};
-    arg0 = builder->create<mlir::LLVM::CallOp>(loc, check_size_func, args).getResult();
-
-    // Prevents division by zero when rhs size increased
-    mlir::Value default_value;
-    if (op == vcalc::VCalcParser::DIV) {
-        default_value = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
-    } else {
-        default_value = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 0);
+    // The unchecked variant is only called when codegen knows both sizes are equal
+    if (!unchecked) {
+        mlir::LLVM::LLVMFuncOp check_size_func = GetHelper("match_vector_size");
+
+        // Increases lhs vector size if required
+        mlir::ValueRange args = {arg0,arg1,zero};
+        arg0 = builder->create<mlir::LLVM::CallOp>(loc, check_size_func, args).getResult();
+
+        // Prevents division by zero when rhs size increased
+        mlir::Value default_value;
+        if (op == vcalc::VCalcParser::DIV) {
+            default_value = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
+        } else {
+            default_value = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 0);
+        }
+
+        // Increases rhs vector size if required
+        mlir::ValueRange args1 = {arg1,arg0,default_value};
+        arg1 = builder->create<mlir::LLVM::CallOp>(loc, check_size_func, args1).getResult();
     }
 
-    // Increases rhs vector size if required
-    mlir::ValueRange args1 = {arg1,arg0,default_value};
-    arg1 = builder->create<mlir::LLVM::CallOp>(loc, check_size_func, args1).getResult();
-
 
     mlir::Value arr_0 = builder->create<mlir::LLVM::GEPOp>(loc,ptr_type,int_type,arg0,mlir::ValueRange{one});
     mlir::Value arr0_size_addr = builder->create<mlir::LLVM::GEPOp>(loc,ptr_type,int_type,arg0,mlir::ValueRange{zero});
@@ -457,11 +686,83 @@ void BackEnd::CreateVectorOperationFunction(size_t op) {
         vector_func.Generate(this,func,result_ptr,arr_size);
     }
     it = bool_operations.find(op);
-    if (it != arithmetic_operations.end()) {
+    if (it != bool_operations.end()) {
         auto vector_func = VectorBooleanOperationFunction(op, arr_0, arr_1);
         vector_func.Generate(this,func,result_ptr,arr_size);
     }
 
+    // Frees the padded copies made by match_vector_size, the arguments themselves belong to the caller
+    if (!unchecked) {
+        mlir::Value null_ptr = GenerateNullPtr();
+        mlir::Value arg0_copied = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::ne, arg0, entryBlock->getArgument(0));
+        FreeVector(builder->create<mlir::LLVM::SelectOp>(loc, arg0_copied, arg0, null_ptr));
+        mlir::Value arg1_copied = builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::ne, arg1, entryBlock->getArgument(1));
+        FreeVector(builder->create<mlir::LLVM::SelectOp>(loc, arg1_copied, arg1, null_ptr));
+    }
+
+    builder->create<mlir::LLVM::ReturnOp>(loc, result_ptr);
+    builder->setInsertionPointToStart(module.getBody());
+}
+
+mlir::LLVM::LLVMFuncOp BackEnd::GetRuntimeFunction(const std::string &name, llvm::ArrayRef<mlir::Type> arg_types,
+                                                   mlir::Type result_type) {
+    if (auto func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>(name)) {
+        return func;
+    }
+    mlir::OpBuilder::InsertionGuard guard(*builder);
+    builder->setInsertionPointToStart(module.getBody());
+    if (!result_type) {
+        result_type = mlir::LLVM::LLVMVoidType::get(&context);
+    }
+    auto type = mlir::LLVM::LLVMFunctionType::get(result_type, arg_types);
+    return builder->create<mlir::LLVM::LLVMFuncOp>(loc, name, type, mlir::LLVM::Linkage::ExternWeak);
+}
+
+mlir::Value BackEnd::GenerateRuntimeLinked(mlir::LLVM::LLVMFuncOp func) {
+    // Unresolved extern_weak symbols have a null address
+    mlir::Value func_ptr = builder->create<mlir::LLVM::AddressOfOp>(loc, func);
+    mlir::Value func_addr = builder->create<mlir::LLVM::PtrToIntOp>(loc, builder->getI64Type(), func_ptr);
+    mlir::Value null_addr = builder->create<mlir::LLVM::ConstantOp>(loc, builder->getI64Type(), 0);
+    return builder->create<mlir::LLVM::ICmpOp>(loc, mlir::LLVM::ICmpPredicate::ne, func_addr, null_addr);
+}
+
+std::string BackEnd::GetScalarOperationFunc(size_t op, bool scalar_lhs) {
+    if (scalar_lhs) {
+        return GetOperationFunc(op, Type::VCalcTypes::INT) + "_vector";
+    }
+    return GetOperationFunc(op, Type::VCalcTypes::VECTOR) + "_int";
+}
+
+// Generates a mlir function which applies op between a vector and an int without promoting the int to a vector.
+// Eg vector_mul_int([1,2,3],2) -> [2,4,6], int_sub_vector(1,[1,2,3]) -> [0,-1,-2]
+void BackEnd::CreateVectorScalarOperationFunction(size_t op, bool scalar_lhs) {
+    std::string func_name = GetScalarOperationFunc(op, scalar_lhs);
+    mlir::LLVM::LLVMFunctionType type;
+    if (scalar_lhs) {
+        type = mlir::LLVM::LLVMFunctionType::get(ptr_type, {int_type,ptr_type},true);
+    } else {
+        type = mlir::LLVM::LLVMFunctionType::get(ptr_type, {ptr_type,int_type},true);
+    }
+    auto func = builder->create<mlir::LLVM::LLVMFuncOp>(loc, func_name, type);
+    auto *entryBlock = func.addEntryBlock();
+
+    /// ENTRY
+    builder->setInsertionPointToStart(entryBlock);
+    mlir::Value zero = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 0);
+    mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
+
+    mlir::Value vector_arg = entryBlock->getArgument(scalar_lhs ? 1 : 0);
+    mlir::Value scalar_arg = entryBlock->getArgument(scalar_lhs ? 0 : 1);
+
+    mlir::Value arr_size_addr = builder->create<mlir::LLVM::GEPOp>(loc,ptr_type,int_type,vector_arg,mlir::ValueRange{zero});
+    mlir::Value arr_size = builder->create<mlir::LLVM::LoadOp>(loc,int_type,arr_size_addr);
+    mlir::Value arr = builder->create<mlir::LLVM::GEPOp>(loc,ptr_type,int_type,vector_arg,mlir::ValueRange{one});
+
+    mlir::Value result_ptr = GenerateVectorTypePtr(arr_size);
+
+    auto vector_func = VectorScalarOperationFunction(op, arr, scalar_arg, scalar_lhs);
+    vector_func.Generate(this,func,result_ptr,arr_size);
+
     builder->create<mlir::LLVM::ReturnOp>(loc, result_ptr);
     builder->setInsertionPointToStart(module.getBody());
 }
@@ -483,7 +784,7 @@ void BackEnd::CreateVectorMatchSizeFunction() {
 
     mlir::Value zero = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 0);
     //mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
-    mlir::LLVM::LLVMFuncOp copy_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("increase_vector_size");
+    mlir::LLVM::LLVMFuncOp copy_func = GetHelper("increase_vector_size");
 
     mlir::Value arr0_size_addr = builder->create<mlir::LLVM::GEPOp>(loc,ptr_type,int_type,arg0,mlir::ValueRange{zero});
     mlir::Value arr_0_size = builder->create<mlir::LLVM::LoadOp>(loc,int_type,arr0_size_addr);
@@ -528,31 +829,48 @@ void BackEnd::SwitchAndFreeVector(mlir::Value vector_ptr, mlir::Value copy_vecto
     builder->create<mlir::LLVM::StoreOp>(loc, copy_arr_size, arr_size_ptr);
 }
 
+mlir::Value BackEnd::GenerateNullPtr() {
+    mlir::Value zero = builder->create<mlir::LLVM::ConstantOp>(loc, builder->getI64Type(), 0);
+    return builder->create<mlir::LLVM::IntToPtrOp>(loc, ptr_type, zero);
+}
+
+mlir::Value BackEnd::ShrinkVector(mlir::Value vector_ptr, mlir::Value arr_size) {
+    mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
+    mlir::Type size_type = builder->getI64Type();
+    mlir::LLVM::LLVMFuncOp reallocFn = mlir::LLVM::lookupOrCreateFn(module, "realloc", {ptr_type, size_type}, ptr_type);
+
+    // Same layout as GenerateVectorTypePtr, one extra int for the size header
+    mlir::Value int_size = builder->create<mlir::LLVM::ConstantOp>(loc, size_type, 4);
+    mlir::Value alloc_elems = builder->create<mlir::LLVM::AddOp>(loc, arr_size, one);
+    mlir::Value alloc_elems_wide = builder->create<mlir::LLVM::ZExtOp>(loc, size_type, alloc_elems);
+    mlir::Value alloc_size = builder->create<mlir::LLVM::MulOp>(loc, alloc_elems_wide, int_size);
+    mlir::ValueRange args = {vector_ptr, alloc_size};
+    return builder->create<mlir::LLVM::CallOp>(loc, reallocFn, args).getResult();
+}
+
+void BackEnd::FreeVector(mlir::Value vector_ptr) {
+    // A vector is a single allocation so freeing the header frees the elements too, free(null) is a no-op
+    mlir::LLVM::LLVMFuncOp freeFn = mlir::LLVM::lookupOrCreateFreeFn(module);
+    builder->create<mlir::LLVM::CallOp>(loc, freeFn, mlir::ValueRange{vector_ptr});
+}
+
 mlir::Value BackEnd::GenerateVectorTypePtr(mlir::Value arr_size) {
+    // A vector is a single allocation laid out as [size, elem_0, elem_1, ...]
     mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
     mlir::Value zero = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 0);
 
-
     mlir::LLVM::LLVMFuncOp mallocFn = mlir::LLVM::lookupOrCreateMallocFn(module, int_type);
-    mlir::Value eight = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 8);
-
-    mlir::Value vectorAddr = builder->create<mlir::LLVM::CallOp>(
-            loc, mallocFn, mlir::ValueRange{eight}).getResult();
 
-    // Calculate size in bytes
+    // Calculate size in bytes, one extra int for the size header
     mlir::Value int_size = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 4);
-    mlir::Value alloc_arr_size = builder->create<mlir::LLVM::MulOp>(loc,arr_size,int_size);
+    mlir::Value alloc_elems = builder->create<mlir::LLVM::AddOp>(loc, arr_size, one);
+    mlir::Value alloc_size = builder->create<mlir::LLVM::MulOp>(loc, alloc_elems, int_size);
 
-    // Allocate space for int32 arr
-    mlir::Value arrayAddr = builder->create<mlir::LLVM::CallOp>(
-            loc, mallocFn, mlir::ValueRange{alloc_arr_size}).getResult();
-
-    mlir::Value arrayPtr = builder->create<mlir::LLVM::GEPOp>(
-            loc, ptr_type, vector_type, vectorAddr, mlir::ValueRange{one});
-    builder->create<mlir::LLVM::StoreOp>(loc,arrayAddr,arrayPtr);
+    mlir::Value vectorAddr = builder->create<mlir::LLVM::CallOp>(
+            loc, mallocFn, mlir::ValueRange{alloc_size}).getResult();
 
     mlir::Value sizeAddr = builder->create<mlir::LLVM::GEPOp>(
-            loc, ptr_type, vector_type, vectorAddr, mlir::ValueRange{zero});
+            loc, ptr_type, int_type, vectorAddr, mlir::ValueRange{zero});
     builder->create<mlir::LLVM::StoreOp>(loc, arr_size, sizeAddr);
     return vectorAddr;
 }
@@ -718,7 +1036,7 @@ void BackEnd::CreateVectorIndexVectorOperation() {
         mlir::ValueRange{one}
     );
 
-    mlir::LLVM::LLVMFuncOp index_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_index");
+    mlir::LLVM::LLVMFuncOp index_func = GetHelper("vector_index");
     mlir::scf::ForOp for_loop = builder->create<mlir::scf::ForOp>(loc, zero, index_arr_size, one);
     mlir::Value loop_index = for_loop.getInductionVar();
     mlir::Block *for_loop_body = for_loop.getBody();
@@ -751,11 +1069,10 @@ void BackEnd::CreatePrintVectorOperation() {
     auto *entryBlock = func.addEntryBlock();
     builder->setInsertionPointToStart(entryBlock);
 
-    PrintChar('[');
     mlir::Value vector_ptr = entryBlock->getArgument(0);
 
     mlir::Value zero = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 0);
-    //mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
+    mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
 
     mlir::Value size_addr = builder->create<mlir::LLVM::GEPOp>(
             loc,
@@ -766,6 +1083,20 @@ void BackEnd::CreatePrintVectorOperation() {
     );
     mlir::Value arr_size = builder->create<mlir::LLVM::LoadOp>(loc,int_type,size_addr);
 
+    // The vcalcrt buffered writer prints the whole vector in one call when the program is linked against it,
+    // otherwise fall back to printf per element
+    mlir::Value arr_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, vector_ptr, mlir::ValueRange{one});
+    mlir::LLVM::LLVMFuncOp runtime_print = GetRuntimeFunction("vcalcrt_print_vector", {ptr_type, int_type});
+    mlir::Block *runtime_block = func.addBlock();
+    mlir::Block *printf_block = func.addBlock();
+    builder->create<mlir::LLVM::CondBrOp>(loc, GenerateRuntimeLinked(runtime_print), runtime_block, printf_block);
+
+    builder->setInsertionPointToStart(runtime_block);
+    builder->create<mlir::LLVM::CallOp>(loc, runtime_print, mlir::ValueRange{arr_ptr, arr_size});
+    builder->create<mlir::LLVM::ReturnOp>(loc, vector_ptr);
+
+    builder->setInsertionPointToStart(printf_block);
+    PrintChar('[');
     auto vector_func = VectorPrintFunction();
     vector_func.Generate(this,func,vector_ptr,arr_size);
 
@@ -776,6 +1107,36 @@ void BackEnd::CreatePrintVectorOperation() {
     builder->setInsertionPointToStart(module.getBody());
 }
 
+void BackEnd::CreatePrintIntOperation() {
+    std::string func_name = "print_int";
+    mlir::Type void_type = mlir::LLVM::LLVMVoidType::get(&context);
+    auto type = mlir::LLVM::LLVMFunctionType::get(void_type, {int_type},true);
+    auto func = builder->create<mlir::LLVM::LLVMFuncOp>(loc, func_name, type);
+
+    auto *entryBlock = func.addEntryBlock();
+    builder->setInsertionPointToStart(entryBlock);
+    mlir::Value value = entryBlock->getArgument(0);
+
+    // Same buffered writer as print_vector so the output of both stays in order
+    mlir::LLVM::LLVMFuncOp runtime_print = GetRuntimeFunction("vcalcrt_print_int", {int_type});
+    mlir::Block *runtime_block = func.addBlock();
+    mlir::Block *printf_block = func.addBlock();
+    builder->create<mlir::LLVM::CondBrOp>(loc, GenerateRuntimeLinked(runtime_print), runtime_block, printf_block);
+
+    builder->setInsertionPointToStart(runtime_block);
+    builder->create<mlir::LLVM::CallOp>(loc, runtime_print, mlir::ValueRange{value});
+    builder->create<mlir::LLVM::ReturnOp>(loc,nullptr);
+
+    builder->setInsertionPointToStart(printf_block);
+    auto int_format = module.lookupSymbol<mlir::LLVM::GlobalOp>("int_new_line_format");
+    mlir::Value int_format_ptr = builder->create<mlir::LLVM::AddressOfOp>(loc, int_format);
+    mlir::LLVM::LLVMFuncOp printf_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("printf");
+    builder->create<mlir::LLVM::CallOp>(loc, printf_func, mlir::ValueRange{int_format_ptr, value});
+    builder->create<mlir::LLVM::ReturnOp>(loc,nullptr);
+
+    builder->setInsertionPointToStart(module.getBody());
+}
+
 void BackEnd::CreateVectorSizePromotionFunction() {
     std::string func_name = "increase_vector_size";
     auto type = mlir::LLVM::LLVMFunctionType::get(ptr_type, {ptr_type,int_type,int_type},true);
@@ -816,6 +1177,34 @@ void BackEnd::CreateVectorSizePromotionFunction() {
     builder->setInsertionPointToStart(module.getBody());
 }
 
+// Generates a mlir function which returns a copy of a vector, used when a variable is assigned another variable
+// Eg vector_copy([1,2,3]) -> [1,2,3]
+void BackEnd::CreateVectorCopyFunction() {
+    std::string func_name = "vector_copy";
+    auto type = mlir::LLVM::LLVMFunctionType::get(ptr_type, {ptr_type},true);
+    auto func = builder->create<mlir::LLVM::LLVMFuncOp>(loc, func_name, type);
+
+    auto *entryBlock = func.addEntryBlock();
+    builder->setInsertionPointToStart(entryBlock);
+
+    mlir::Value vector_ptr = entryBlock->getArgument(0);
+
+    mlir::Value zero = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 0);
+    mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
+
+    mlir::Value size_addr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, vector_ptr, mlir::ValueRange{zero});
+    mlir::Value arr_size = builder->create<mlir::LLVM::LoadOp>(loc,int_type,size_addr);
+    mlir::Value copy_arr_ptr = builder->create<mlir::LLVM::GEPOp>(loc, ptr_type, int_type, vector_ptr, mlir::ValueRange{one});
+
+    mlir::Value new_vector = GenerateVectorTypePtr(arr_size);
+
+    // Same size as the source so every element is copied and the default is never used
+    auto vector_func = IncreaseVectorSizeMLIRFunction(copy_arr_ptr, arr_size, zero);
+    vector_func.Generate(this,func,new_vector,arr_size);
+
+    builder->create<mlir::LLVM::ReturnOp>(loc, new_vector);
+    builder->setInsertionPointToStart(module.getBody());
+}
 
 void BackEnd::TestArithmeticInt(mlir::ValueRange args, mlir::LLVM::LLVMFuncOp func, mlir::Value formatStringPtr) {
     auto result = builder->create<mlir::LLVM::CallOp>(loc, func, args);
@@ -827,7 +1216,7 @@ void BackEnd::TestArithmeticInt(mlir::ValueRange args, mlir::LLVM::LLVMFuncOp fu
 }
 
 void BackEnd::TestIndex(mlir::ValueRange args) {
-    auto index_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("vector_index");
+    auto index_func = GetHelper("vector_index");
     auto index_func_call = builder->create<mlir::LLVM::CallOp>(loc,index_func,args);
     auto val = index_func_call.getResult();
     PrintInt(val);
@@ -858,7 +1247,7 @@ void BackEnd::TestVectorOp(mlir::ValueRange args, mlir::LLVM::LLVMFuncOp func) {
     auto vec_func_call = builder->create<mlir::LLVM::CallOp>(loc,func,args);
     auto vec = vec_func_call.getResult();
 
-    auto print_vec = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("print_vector");
+    auto print_vec = GetHelper("print_vector");
     builder->create<mlir::LLVM::CallOp>(loc,print_vec,mlir::ValueRange{vec});
 }
 
@@ -916,28 +1305,53 @@ void VectorLoopMLIRFunction::Generate(BackEnd* backend, mlir::LLVM::LLVMFuncOp f
     mlir::Block *body = func.addBlock();
     mlir::Block *merge = func.addBlock();
 
+    /// ============== RUNTIME KERNEL ==============
+    // Large vectors go to the vcalcrt SIMD kernel if the program is linked against it, otherwise
+    // jump immediately into the pre-header (no fallthrough in LLVM)
+    std::string kernel_name = RuntimeKernelName(backend);
+    if (kernel_name.empty()) {
+        builder->create<mlir::LLVM::BrOp>(loc, preHeader);
+    } else {
+        std::vector<mlir::Value> kernel_args = {arr_ptr};
+        for (mlir::Value arg : RuntimeKernelArgs()) {
+            kernel_args.push_back(arg);
+        }
+        kernel_args.push_back(upper_bound);
+        std::vector<mlir::Type> kernel_arg_types;
+        for (mlir::Value arg : kernel_args) {
+            kernel_arg_types.push_back(arg.getType());
+        }
+        mlir::LLVM::LLVMFuncOp kernel = backend->GetRuntimeFunction(kernel_name, kernel_arg_types);
+
+        mlir::Value threshold = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, runtime_kernel_threshold);
+        mlir::Value is_large = builder->create<mlir::LLVM::ICmpOp>(
+                loc, mlir::LLVM::ICmpPredicate::sge, upper_bound, threshold);
+        mlir::Value is_linked = backend->GenerateRuntimeLinked(kernel);
+        mlir::Value use_kernel = builder->create<mlir::LLVM::AndOp>(loc, is_large, is_linked);
+
+        mlir::Block *kernel_block = func.addBlock();
+        builder->create<mlir::LLVM::CondBrOp>(loc, use_kernel, kernel_block, preHeader);
+        builder->setInsertionPointToStart(kernel_block);
+        builder->create<mlir::LLVM::CallOp>(loc, kernel, kernel_args);
+        builder->create<mlir::LLVM::BrOp>(loc, merge);
+    }
+
     /// ============== PRE-HEADER ==============
-    // First, jump immediately into the pre-header (no fallthrough in LLVM)
-    builder->create<mlir::LLVM::BrOp>(loc, preHeader);
     builder->setInsertionPointToStart(preHeader);
 
-    // Init the induction variable
+    // Init the induction variable, it is passed to the header as a block argument so it never touches memory
     mlir::Value zero = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 0);
     mlir::Value one = builder->create<mlir::LLVM::ConstantOp>(loc, int_type, 1);
 
-    mlir::Value iAddr = builder->create<mlir::LLVM::AllocaOp>(
-            loc, ptr_type, int_type, one);
-    builder->create<mlir::LLVM::StoreOp>(loc, zero, iAddr);
-
     PreHeaderFunc(backend);
 
-    builder->create<mlir::LLVM::BrOp>(loc, header);
+    builder->create<mlir::LLVM::BrOp>(loc, mlir::ValueRange{zero}, header);
 
     /// ============== HEADER ==============
     builder->setInsertionPointToStart(header);
 
-    // Load the induction variable and compare
-    mlir::Value iValue = builder->create<mlir::LLVM::LoadOp>(loc, int_type, iAddr);
+    // Compare the induction variable
+    mlir::Value iValue = header->addArgument(int_type, loc);
     mlir::Value ltCond = builder->create<mlir::LLVM::ICmpOp>(
             loc, mlir::LLVM::ICmpPredicate::slt, iValue, upper_bound);
     builder->create<mlir::LLVM::CondBrOp>(loc, ltCond, body, merge);
@@ -948,10 +1362,7 @@ void VectorLoopMLIRFunction::Generate(BackEnd* backend, mlir::LLVM::LLVMFuncOp f
     LoopFunc(backend, iValue, arr_ptr, upper_bound, func);
     // Iterate iterator
     mlir::Value iIncrement = builder->create<mlir::LLVM::AddOp>(loc, int_type, iValue, one);
-    builder->create<mlir::LLVM::StoreOp>(loc, iIncrement, iAddr);
-
-
-    builder->create<mlir::LLVM::BrOp>(loc, header);
+    builder->create<mlir::LLVM::BrOp>(loc, mlir::ValueRange{iIncrement}, header);
 
     /// ============== MERGE ==============
     builder->setInsertionPointToStart(merge);
@@ -961,6 +1372,57 @@ VectorLoopMLIRFunction::VectorLoopMLIRFunction() {
 
 }
 
+std::string VectorLoopMLIRFunction::RuntimeKernelName(BackEnd *backend) {
+    return "";
+}
+
+std::vector<mlir::Value> VectorLoopMLIRFunction::RuntimeKernelArgs() {
+    return {};
+}
+
+std::string IntVectorPromotionFunction::RuntimeKernelName(BackEnd *backend) {
+    return "vcalcrt_vector_broadcast";
+}
+
+std::vector<mlir::Value> IntVectorPromotionFunction::RuntimeKernelArgs() {
+    return {const_value};
+}
+
+std::string RangeVectorFunction::RuntimeKernelName(BackEnd *backend) {
+    return "vcalcrt_vector_range";
+}
+
+std::vector<mlir::Value> RangeVectorFunction::RuntimeKernelArgs() {
+    return {lower_bound};
+}
+
+std::string VectorArithmeticOperationFunction::RuntimeKernelName(BackEnd *backend) {
+    return "vcalcrt_" + backend->GetOperationFunc(op, Type::VCalcTypes::VECTOR);
+}
+
+std::vector<mlir::Value> VectorArithmeticOperationFunction::RuntimeKernelArgs() {
+    return {arr0_ptr, arr1_ptr};
+}
+
+std::string VectorScalarOperationFunction::RuntimeKernelName(BackEnd *backend) {
+    return "vcalcrt_" + backend->GetScalarOperationFunc(op, scalar_lhs);
+}
+
+std::vector<mlir::Value> VectorScalarOperationFunction::RuntimeKernelArgs() {
+    if (scalar_lhs) {
+        return {scalar, vector_arr_ptr};
+    }
+    return {vector_arr_ptr, scalar};
+}
+
+std::string VectorBooleanOperationFunction::RuntimeKernelName(BackEnd *backend) {
+    return "vcalcrt_" + backend->GetOperationFunc(op, Type::VCalcTypes::VECTOR);
+}
+
+std::vector<mlir::Value> VectorBooleanOperationFunction::RuntimeKernelArgs() {
+    return {arr0_ptr, arr1_ptr};
+}
+
 void IntVectorPromotionFunction::PreHeaderFunc(BackEnd *backend) {
 
 }
@@ -1022,22 +1484,38 @@ void VectorArithmeticOperationFunction::LoopFunc(BackEnd *backend, mlir::Value i
     );
     mlir::Value arr1_val = builder->create<mlir::LLVM::LoadOp>(loc,int_type,arr1_element_ptr);
 
+    mlir::Value result = backend->CreateIntArithmetic(op, arr0_val, arr1_val);
+
+    mlir::Value result_element_ptr = builder->create<mlir::LLVM::GEPOp>(
+            loc,
+            ptr_type,
+            int_type,
+            arr_ptr,
+            mlir::ValueRange{i_value}
+    );
+    builder->create<mlir::LLVM::StoreOp>(loc, result, result_element_ptr);
+}
+
+void VectorScalarOperationFunction::LoopFunc(BackEnd *backend, mlir::Value i_value, mlir::Value arr_ptr, mlir::Value arr_size, mlir::LLVM::LLVMFuncOp func) {
+    auto loc = backend->GetLocation();
+    auto builder = backend->GetBuilder();
+    auto int_type = backend->GetMLIRType(BackendMLIRType::Int);
+    auto ptr_type = backend->GetMLIRType(BackendMLIRType::Ptr);
+
+    mlir::Value element_ptr = builder->create<mlir::LLVM::GEPOp>(
+            loc,
+            ptr_type,
+            int_type,
+            vector_arr_ptr,
+            mlir::ValueRange{i_value}
+    );
+    mlir::Value element = builder->create<mlir::LLVM::LoadOp>(loc,int_type,element_ptr);
+
     mlir::Value result;
-    switch (op) {
-        case vcalc::VCalcParser::ADD:
-            result = builder->create<mlir::LLVM::AddOp>(loc, arr0_val, arr1_val);
-            break;
-        case vcalc::VCalcParser::SUB:
-            result = builder->create<mlir::LLVM::SubOp>(loc, arr0_val, arr1_val);
-            break;
-        case vcalc::VCalcParser::DIV:
-            result = builder->create<mlir::LLVM::SDivOp>(loc, arr0_val, arr1_val);
-            break;
-        case vcalc::VCalcParser::MUL:
-            result = builder->create<mlir::LLVM::MulOp>(loc, arr0_val, arr1_val);
-            break;
-        default:
-            break;
+    if (scalar_lhs) {
+        result = backend->CreateIntOperation(op, scalar, element);
+    } else {
+        result = backend->CreateIntOperation(op, element, scalar);
     }
 
     mlir::Value result_element_ptr = builder->create<mlir::LLVM::GEPOp>(
@@ -1074,9 +1552,7 @@ void VectorBooleanOperationFunction::LoopFunc(BackEnd *backend, mlir::Value i_va
     );
     mlir::Value arr1_val = builder->create<mlir::LLVM::LoadOp>(loc,int_type,arr1_element_ptr);
 
-    mlir::ValueRange args = {arr0_val,arr1_val};
-    auto func_call = builder->create<mlir::LLVM::CallOp>(loc, bool_int_func, args);
-    auto result = func_call.getResult();
+    mlir::Value result = backend->CreateIntBoolean(op, arr0_val, arr1_val);
 
     mlir::Value result_element_ptr = builder->create<mlir::LLVM::GEPOp>(
             loc,
@@ -1090,16 +1566,8 @@ void VectorBooleanOperationFunction::LoopFunc(BackEnd *backend, mlir::Value i_va
 
 }
 
-void VectorBooleanOperationFunction::PreHeaderFunc(BackEnd *backend) {
-    auto module = backend->GetModule();
-    std::string func_name = backend->GetOperationFunc(op,Type::VCalcTypes::INT);
-    bool_int_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>(func_name);
-
-}
-
 void VectorPrintFunction::LoopFunc(BackEnd *backend, mlir::Value i_value, mlir::Value arr_ptr, mlir::Value arr_size,mlir::LLVM::LLVMFuncOp func) {
     auto loc = backend->GetLocation();
-    auto module = backend->GetModule();
     auto builder = backend->GetBuilder();
     auto int_type = backend->GetMLIRType(BackendMLIRType::Int);
     auto ptr_type = backend->GetMLIRType(BackendMLIRType::Ptr);
@@ -1118,7 +1586,7 @@ void VectorPrintFunction::LoopFunc(BackEnd *backend, mlir::Value i_value, mlir::
     backend->PrintInt(val);
 
     mlir::ValueRange print_args = {iIncrement, arr_size};
-    mlir::LLVM::LLVMFuncOp printfFunc = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("cond_print_space");
+    mlir::LLVM::LLVMFuncOp printfFunc = backend->GetHelper("cond_print_space");
     builder->create<mlir::LLVM::CallOp>(loc, printfFunc, print_args);
 }
 
@@ -1132,6 +1600,5 @@ void IncreaseVectorSizeMLIRFunction::LoopFunc(BackEnd *backend, mlir::Value i_va
 }
 
 void IncreaseVectorSizeMLIRFunction::PreHeaderFunc(BackEnd *backend) {
-    auto module = backend->GetModule();
-    cond_set_func = module.lookupSymbol<mlir::LLVM::LLVMFuncOp>("cond_copy_arr");
+    cond_set_func = backend->GetHelper("cond_copy_arr");
 }
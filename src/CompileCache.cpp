@@ -0,0 +1,149 @@
+#include "CompileCache.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SHA256.h"
+#include "llvm/ADT/StringExtras.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <elf.h>
+#include <link.h>
+#include <unistd.h>
+
+namespace CompileCache{
+
+Cache::Cache(const std::string &directory, uintmax_t max_bytes): directory(directory), max_bytes(max_bytes) {}
+
+std::string Cache::HashFiles(const std::vector<std::string> &paths){
+    llvm::SHA256 hasher;
+    for (const std::string &path : paths){
+        if (path.empty()){
+            continue;
+        }
+        llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> buffer = llvm::MemoryBuffer::getFile(path);
+        if (!buffer){
+            return "";
+        }
+        hasher.update((*buffer)->getBuffer());
+        hasher.update(llvm::StringRef("\0", 1));
+    }
+    return llvm::toHex(hasher.final(), true);
+}
+
+std::string Cache::BuildId(){
+    std::string build_id;
+    dl_iterate_phdr([](struct dl_phdr_info *info, size_t, void *data){
+        for (ElfW(Half) i = 0; i < info->dlpi_phnum; i++){
+            const ElfW(Phdr) &segment = info->dlpi_phdr[i];
+            if (segment.p_type != PT_NOTE){
+                continue;
+            }
+            // names and descriptors are padded to the alignment of their segment
+            size_t align = segment.p_align == 8 ? 8 : 4;
+            const char *note = reinterpret_cast<const char *>(info->dlpi_addr + segment.p_vaddr);
+            const char *end = note + segment.p_memsz;
+            while (note + sizeof(ElfW(Nhdr)) <= end){
+                const ElfW(Nhdr) *header = reinterpret_cast<const ElfW(Nhdr) *>(note);
+                const char *name = note + sizeof(ElfW(Nhdr));
+                const char *desc = name + ((header->n_namesz + align - 1) & ~(align - 1));
+                if (header->n_type == NT_GNU_BUILD_ID && header->n_namesz == 4 && !memcmp(name, "GNU", 4)){
+                    *static_cast<std::string *>(data) = llvm::toHex(llvm::StringRef(desc, header->n_descsz), true);
+                    return 1;
+                }
+                note = desc + ((header->n_descsz + align - 1) & ~(align - 1));
+            }
+        }
+        // the executable is always the first object, the shared libraries after it do not identify vcalc
+        return 1;
+    }, &build_id);
+    return build_id;
+}
+
+std::string Cache::Key(const std::string &compiler, const std::string &source, const std::string &options){
+    llvm::SHA256 hasher;
+    // a vcalc build never reuses artifacts of a different one
+    hasher.update(VCALC_CACHE_VERSION);
+    hasher.update(llvm::StringRef("\0", 1));
+    hasher.update(compiler);
+    hasher.update(llvm::StringRef("\0", 1));
+    hasher.update(options);
+    hasher.update(llvm::StringRef("\0", 1));
+    hasher.update(source);
+    return llvm::toHex(hasher.final(), true);
+}
+
+std::filesystem::path Cache::EntryPath(const std::string &key){
+    return directory / key;
+}
+
+bool Cache::Fetch(const std::string &key, const std::string &output_path){
+    std::error_code error;
+    std::filesystem::path entry = EntryPath(key);
+    std::filesystem::copy_file(entry, output_path, std::filesystem::copy_options::overwrite_existing, error);
+    if (error){
+        return false;
+    }
+    // mark the entry as recently used
+    std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), error);
+    return true;
+}
+
+void Cache::Store(const std::string &key, const std::string &artifact_path){
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error){
+        return;
+    }
+    // copy next to the entry then rename, the rename is atomic within the directory. The name is unique per
+    // process and thread since batch workers may store the same key at once.
+    size_t thread_id = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    std::filesystem::path temp = directory / (key + "." + std::to_string(getpid()) + "." + std::to_string(thread_id) + ".tmp");
+    std::filesystem::copy_file(artifact_path, temp, std::filesystem::copy_options::overwrite_existing, error);
+    if (!error){
+        std::filesystem::rename(temp, EntryPath(key), error);
+    }
+    if (error){
+        std::filesystem::remove(temp, error);
+        return;
+    }
+    Evict();
+}
+
+void Cache::Evict(){
+    struct Entry{
+        std::filesystem::path path;
+        std::filesystem::file_time_type last_used;
+        uintmax_t size;
+    };
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+    std::error_code error;
+    for (const auto &file : std::filesystem::directory_iterator(directory, error)){
+        // temporary files belong to writers that are still running
+        if (!file.is_regular_file(error) || file.path().extension() == ".tmp"){
+            continue;
+        }
+        Entry entry = {file.path(), file.last_write_time(error), file.file_size(error)};
+        if (error){
+            continue;
+        }
+        total += entry.size;
+        entries.push_back(entry);
+    }
+    if (total <= max_bytes){
+        return;
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b){
+        return a.last_used < b.last_used;
+    });
+    for (const Entry &entry : entries){
+        if (total <= max_bytes){
+            break;
+        }
+        // another vcalc may have evicted it already
+        std::filesystem::remove(entry.path, error);
+        total -= entry.size;
+    }
+}
+
+}
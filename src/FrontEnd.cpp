@@ -0,0 +1,545 @@
+#include "FrontEnd.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace FrontEnd{
+
+static_assert(vcalc::VCalcParser::COMMENT < 64 && vcalc::VCalcParser::FILTER < 64, "token types must fit a TokenSet");
+
+static constexpr TokenSet Bit(size_t type){
+    return type == antlr4::Token::EOF ? 1 : TokenSet(1) << type;
+}
+
+static bool Contains(TokenSet set, size_t type){
+    return (set & Bit(type)) != 0;
+}
+
+// first tokens of a statement
+static constexpr TokenSet statement_starts = Bit(vcalc::VCalcParser::TYPE) | Bit(vcalc::VCalcParser::ID) |
+    Bit(vcalc::VCalcParser::T__9) | Bit(vcalc::VCalcParser::T__11) | Bit(vcalc::VCalcParser::T__13);
+
+// first tokens of an expression, '(' '[' ID INT
+static constexpr TokenSet expr_starts = Bit(vcalc::VCalcParser::T__0) | Bit(vcalc::VCalcParser::T__2) |
+    Bit(vcalc::VCalcParser::ID) | Bit(vcalc::VCalcParser::INT);
+
+// tokens that continue an expression, the operators and the '[' of an index
+static constexpr TokenSet expr_operators = Bit(vcalc::VCalcParser::T__2) | Bit(vcalc::VCalcParser::DOTS) |
+    Bit(vcalc::VCalcParser::MUL) | Bit(vcalc::VCalcParser::DIV) | Bit(vcalc::VCalcParser::ADD) |
+    Bit(vcalc::VCalcParser::SUB) | Bit(vcalc::VCalcParser::LESS) | Bit(vcalc::VCalcParser::GREATER) |
+    Bit(vcalc::VCalcParser::LOGEQ) | Bit(vcalc::VCalcParser::LOGNEQ);
+
+// precedence of the operator alternatives of expr, earlier ones bind tighter, 0 when type is not an operator
+static int Precedence(size_t type){
+    switch (type){
+        case vcalc::VCalcParser::T__2:
+            return 6;
+        case vcalc::VCalcParser::DOTS:
+            return 5;
+        case vcalc::VCalcParser::MUL:
+        case vcalc::VCalcParser::DIV:
+            return 4;
+        case vcalc::VCalcParser::ADD:
+        case vcalc::VCalcParser::SUB:
+            return 3;
+        case vcalc::VCalcParser::LESS:
+        case vcalc::VCalcParser::GREATER:
+            return 2;
+        case vcalc::VCalcParser::LOGEQ:
+        case vcalc::VCalcParser::LOGNEQ:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+std::string TokenDisplayName(size_t type){
+    switch (type){
+        case antlr4::Token::EOF: return "<EOF>";
+        case vcalc::VCalcParser::T__0: return "'('";
+        case vcalc::VCalcParser::T__1: return "')'";
+        case vcalc::VCalcParser::T__2: return "'['";
+        case vcalc::VCalcParser::T__3: return "']'";
+        case vcalc::VCalcParser::T__4: return "'in'";
+        case vcalc::VCalcParser::T__5: return "'|'";
+        case vcalc::VCalcParser::T__6: return "'&'";
+        case vcalc::VCalcParser::T__7: return "';'";
+        case vcalc::VCalcParser::T__8: return "'='";
+        case vcalc::VCalcParser::T__9: return "'if'";
+        case vcalc::VCalcParser::T__10: return "'fi'";
+        case vcalc::VCalcParser::T__11: return "'loop'";
+        case vcalc::VCalcParser::T__12: return "'pool'";
+        case vcalc::VCalcParser::T__13: return "'print('";
+        case vcalc::VCalcParser::TYPE: return "TYPE";
+        case vcalc::VCalcParser::ID: return "ID";
+        case vcalc::VCalcParser::INT: return "INT";
+        case vcalc::VCalcParser::MUL: return "'*'";
+        case vcalc::VCalcParser::DIV: return "'/'";
+        case vcalc::VCalcParser::ADD: return "'+'";
+        case vcalc::VCalcParser::SUB: return "'-'";
+        case vcalc::VCalcParser::LESS: return "'<'";
+        case vcalc::VCalcParser::GREATER: return "'>'";
+        case vcalc::VCalcParser::LOGEQ: return "'=='";
+        case vcalc::VCalcParser::LOGNEQ: return "'!='";
+        case vcalc::VCalcParser::DOTS: return "'..'";
+        case vcalc::VCalcParser::BLOCK: return "BLOCK";
+        case vcalc::VCalcParser::IF_BLOCK: return "IF_BLOCK";
+        case vcalc::VCalcParser::LOOP_BLOCK: return "LOOP_BLOCK";
+        case vcalc::VCalcParser::DECL: return "DECL";
+        case vcalc::VCalcParser::ASSIGN: return "ASSIGN";
+        case vcalc::VCalcParser::PRINT: return "PRINT";
+        case vcalc::VCalcParser::EXPR: return "EXPR";
+        case vcalc::VCalcParser::INDEX: return "INDEX";
+        case vcalc::VCalcParser::GENERATOR: return "GENERATOR";
+        case vcalc::VCalcParser::FILTER: return "FILTER";
+        default: return std::to_string(type);
+    }
+}
+
+// returns set as ANTLR's IntervalSet::toString prints it, braces only around more than one token
+static std::string ExpectedString(TokenSet set){
+    std::string names;
+    size_t count = 0;
+    for (size_t bit = 0; bit < 64; bit++){
+        if (set & (TokenSet(1) << bit)){
+            names += (count++ ? ", " : "") + TokenDisplayName(bit == 0 ? antlr4::Token::EOF : bit);
+        }
+    }
+    return count > 1 ? "{" + names + "}" : names;
+}
+
+// escapes line breaks and tabs like ANTLR's error messages do
+static std::string EscapeWhitespace(std::string_view text){
+    std::string escaped;
+    for (char c : text){
+        if (c == '\n'){
+            escaped += "\\n";
+        }
+        else if (c == '\t'){
+            escaped += "\\t";
+        }
+        else if (c == '\r'){
+            escaped += "\\r";
+        }
+        else{
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+static std::string TokenErrorDisplay(const Token &token){
+    return "'" + EscapeWhitespace(token.text) + "'";
+}
+
+void DumpAst(Ast::Node node, std::ostream &os, size_t depth){
+    os << std::string(depth * 2, ' ') << TokenDisplayName(node->GetNodeType());
+    const std::string &text = node->GetText();
+    if (!text.empty()){
+        os << " '" << EscapeWhitespace(text) << "' line " << node->GetLine();
+    }
+    os << "\n";
+    for (auto child : node->GetChildren()){
+        DumpAst(child, os, depth + 1);
+    }
+}
+
+Lexer::Lexer(std::string source) : source(std::move(source)) {
+    // ANTLRInputStream drops a utf-8 byte order mark
+    if (this->source.compare(0, 3, "\xef\xbb\xbf") == 0){
+        position = 3;
+    }
+}
+
+size_t Lexer::CharLength(){
+    unsigned char lead = source[position];
+    size_t length = lead < 0xc0 ? 1 : lead < 0xe0 ? 2 : lead < 0xf0 ? 3 : 4;
+    return std::min(length, source.size() - position);
+}
+
+void Lexer::Consume(){
+    if (source[position] == '\n'){
+        line++;
+        column = 0;
+    }
+    else{
+        column++;
+    }
+    position += CharLength();
+}
+
+void Lexer::ReportError(size_t start, size_t start_line, size_t start_column){
+    if (position < source.size()){
+        Consume();
+    }
+    std::string_view text(source.data() + start, position - start);
+    std::cerr << "line " << start_line << ":" << start_column << " token recognition error at: '"
+              << EscapeWhitespace(text) << "'" << std::endl;
+}
+
+std::vector<Token> Lexer::Tokenize(){
+    std::vector<Token> tokens;
+    // about one token per 4 characters of typical source
+    tokens.reserve(source.size() / 4 + 1);
+    while (position < source.size()){
+        size_t start = position;
+        size_t start_line = line;
+        size_t start_column = column;
+        char c = source[position];
+        char next = position + 1 < source.size() ? source[position + 1] : '\0';
+        size_t type = 0;
+
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n'){
+            Consume();
+            continue;
+        }
+        if (c == '/' && next == '/'){
+            while (position < source.size() && source[position] != '\r' && source[position] != '\n'){
+                Consume();
+            }
+            continue;
+        }
+        if (isalpha((unsigned char)c)){
+            while (position < source.size() && isalnum((unsigned char)source[position])){
+                Consume();
+            }
+            std::string_view word(source.data() + start, position - start);
+            // keywords win over ID on a tie, 'print(' is longer than the word and wins too
+            if (word == "print" && position < source.size() && source[position] == '('){
+                Consume();
+                type = vcalc::VCalcParser::T__13;
+            }
+            else if (word == "int" || word == "vector"){
+                type = vcalc::VCalcParser::TYPE;
+            }
+            else if (word == "in"){
+                type = vcalc::VCalcParser::T__4;
+            }
+            else if (word == "if"){
+                type = vcalc::VCalcParser::T__9;
+            }
+            else if (word == "fi"){
+                type = vcalc::VCalcParser::T__10;
+            }
+            else if (word == "loop"){
+                type = vcalc::VCalcParser::T__11;
+            }
+            else if (word == "pool"){
+                type = vcalc::VCalcParser::T__12;
+            }
+            else{
+                type = vcalc::VCalcParser::ID;
+            }
+        }
+        else if (isdigit((unsigned char)c)){
+            while (position < source.size() && isdigit((unsigned char)source[position])){
+                Consume();
+            }
+            type = vcalc::VCalcParser::INT;
+        }
+        else{
+            switch (c){
+                case '(': type = vcalc::VCalcParser::T__0; break;
+                case ')': type = vcalc::VCalcParser::T__1; break;
+                case '[': type = vcalc::VCalcParser::T__2; break;
+                case ']': type = vcalc::VCalcParser::T__3; break;
+                case '|': type = vcalc::VCalcParser::T__5; break;
+                case '&': type = vcalc::VCalcParser::T__6; break;
+                case ';': type = vcalc::VCalcParser::T__7; break;
+                case '*': type = vcalc::VCalcParser::MUL; break;
+                case '/': type = vcalc::VCalcParser::DIV; break;
+                case '+': type = vcalc::VCalcParser::ADD; break;
+                case '-': type = vcalc::VCalcParser::SUB; break;
+                case '<': type = vcalc::VCalcParser::LESS; break;
+                case '>': type = vcalc::VCalcParser::GREATER; break;
+                case '=':
+                    type = next == '=' ? vcalc::VCalcParser::LOGEQ : vcalc::VCalcParser::T__8;
+                    break;
+                case '!':
+                    type = next == '=' ? vcalc::VCalcParser::LOGNEQ : 0;
+                    break;
+                case '.':
+                    type = next == '.' ? vcalc::VCalcParser::DOTS : 0;
+                    break;
+            }
+            if (type == vcalc::VCalcParser::LOGEQ || type == vcalc::VCalcParser::LOGNEQ ||
+                type == vcalc::VCalcParser::DOTS){
+                Consume();
+                Consume();
+            }
+            else if (type != 0){
+                Consume();
+            }
+            else{
+                // a lone '!' or '.' fails on the character after it, anything else fails right away
+                if (c == '!' || c == '.'){
+                    Consume();
+                }
+                ReportError(start, start_line, start_column);
+                continue;
+            }
+        }
+        tokens.push_back({type, std::string_view(source.data() + start, position - start), start_line, start_column});
+    }
+    tokens.push_back({antlr4::Token::EOF, "<EOF>", line, column});
+    return tokens;
+}
+
+Parser::Parser(std::vector<Token> tokens, Ast::AstArena &arena) : tokens(std::move(tokens)), arena(arena) {}
+
+const Token &Parser::LA(size_t i){
+    return tokens[std::min(current + i - 1, tokens.size() - 1)];
+}
+
+void Parser::Advance(){
+    error_recovery = false;
+    if (current + 1 < tokens.size()){
+        current++;
+    }
+}
+
+void Parser::ReportError(const Token &token, const std::string &message){
+    if (error_recovery){
+        return;
+    }
+    error_recovery = true;
+    std::cerr << "line " << token.line << ":" << token.column << " " << message << std::endl;
+}
+
+void Parser::Fail(const Token &token, const std::string &message){
+    ReportError(token, message);
+    throw std::runtime_error("Syntax error at line " + std::to_string(token.line));
+}
+
+void Parser::FailPrediction(){
+    // the input of the message is the text of every token from where the prediction started
+    std::string input;
+    for (size_t i = pending_prediction; i <= current && tokens[i].type != antlr4::Token::EOF; i++){
+        input += tokens[i].text;
+    }
+    error_recovery = prediction_recovery;
+    Fail(LA(1), "no viable alternative at input '" + EscapeWhitespace(input) + "'");
+}
+
+Token Parser::Match(size_t type, TokenSet follow){
+    Token token = LA(1);
+    if (token.type == type){
+        Advance();
+        return token;
+    }
+    if (pending_prediction != SIZE_MAX){
+        FailPrediction();
+    }
+    if (LA(2).type == type){
+        ReportError(token, "extraneous input " + TokenErrorDisplay(token) + " expecting " + TokenDisplayName(type));
+        Advance();
+        Token matched = LA(1);
+        Advance();
+        return matched;
+    }
+    if (Contains(follow, token.type)){
+        ReportError(token, "missing " + TokenDisplayName(type) + " at " + TokenErrorDisplay(token));
+        // the made up token is placed at the current one, or the last real one at the end of the input
+        Token missing = token.type == antlr4::Token::EOF && current > 0 ? tokens[current - 1] : token;
+        conjured_text.push_back("<missing " + TokenDisplayName(type) + ">");
+        missing.type = type;
+        missing.text = conjured_text.back();
+        return missing;
+    }
+    Fail(token, "mismatched input " + TokenErrorDisplay(token) + " expecting " + TokenDisplayName(type));
+}
+
+Ast::Node Parser::TokenNode(const Token &token){
+    return arena.NewLeaf(token.type, token.text, token.line, token.column);
+}
+
+Ast::Node Parser::ParseFile(){
+    Ast::Node block = ParseBlock();
+    // like the ANTLR file rule the statements before anything that is left over are kept
+    const Token &token = LA(1);
+    if (token.type != antlr4::Token::EOF){
+        if (LA(2).type == antlr4::Token::EOF){
+            ReportError(token, "extraneous input " + TokenErrorDisplay(token) + " expecting <EOF>");
+        }
+        else{
+            ReportError(token, "mismatched input " + TokenErrorDisplay(token) + " expecting <EOF>");
+        }
+    }
+    return block;
+}
+
+// children are made before their parent so a node's child list is appended to the arena in one piece
+Ast::Node Parser::ParseBlock(){
+    std::vector<Ast::Node> statements;
+    while (Contains(statement_starts, LA(1).type)){
+        statements.push_back(ParseStatement());
+    }
+    return arena.NewNode(vcalc::VCalcParser::BLOCK, statements);
+}
+
+Ast::Node Parser::ParseStatement(){
+    Ast::Node node;
+    switch (LA(1).type){
+        case vcalc::VCalcParser::TYPE:
+            node = ParseDeclaration();
+            break;
+        case vcalc::VCalcParser::ID:
+            node = ParseAssignment();
+            break;
+        case vcalc::VCalcParser::T__9:
+            node = ParseConditional(vcalc::VCalcParser::IF_BLOCK, vcalc::VCalcParser::T__10);
+            break;
+        case vcalc::VCalcParser::T__11:
+            node = ParseConditional(vcalc::VCalcParser::LOOP_BLOCK, vcalc::VCalcParser::T__12);
+            break;
+        default:
+            node = ParsePrint();
+            break;
+    }
+    Match(vcalc::VCalcParser::T__7, statement_starts | Bit(block_end));
+    return node;
+}
+
+Ast::Node Parser::ParseDeclaration(){
+    Token type = Match(vcalc::VCalcParser::TYPE, 0);
+    Token id = Match(vcalc::VCalcParser::ID, Bit(vcalc::VCalcParser::T__8) | Bit(vcalc::VCalcParser::T__7));
+    Ast::Node type_node = TokenNode(type);
+    Ast::Node id_node = TokenNode(id);
+    if (LA(1).type == vcalc::VCalcParser::T__8){
+        Advance();
+        Ast::Node assign_id_node = TokenNode(id);
+        Ast::Node assign_node = arena.NewNode(vcalc::VCalcParser::ASSIGN,
+                                              {assign_id_node, ParseExpr(0, Bit(vcalc::VCalcParser::T__7))});
+        return arena.NewNode(vcalc::VCalcParser::DECL, {type_node, id_node, assign_node});
+    }
+    return arena.NewNode(vcalc::VCalcParser::DECL, {type_node, id_node});
+}
+
+Ast::Node Parser::ParseAssignment(){
+    Token id = Match(vcalc::VCalcParser::ID, 0);
+    Match(vcalc::VCalcParser::T__8, expr_starts);
+    Ast::Node id_node = TokenNode(id);
+    return arena.NewNode(vcalc::VCalcParser::ASSIGN, {id_node, ParseExpr(0, Bit(vcalc::VCalcParser::T__7))});
+}
+
+Ast::Node Parser::ParseConditional(size_t node_type, size_t end_type){
+    Advance();
+    Match(vcalc::VCalcParser::T__0, expr_starts);
+    Ast::Node condition = ParseExpr(0, Bit(vcalc::VCalcParser::T__1));
+    Match(vcalc::VCalcParser::T__1, statement_starts | Bit(end_type));
+    size_t outer_block_end = block_end;
+    block_end = end_type;
+    Ast::Node block = ParseBlock();
+    block_end = outer_block_end;
+    Match(end_type, Bit(vcalc::VCalcParser::T__7));
+    return arena.NewNode(node_type, {condition, block});
+}
+
+Ast::Node Parser::ParsePrint(){
+    Advance();
+    Ast::Node expr = ParseExpr(0, Bit(vcalc::VCalcParser::T__1));
+    Match(vcalc::VCalcParser::T__1, Bit(vcalc::VCalcParser::T__7));
+    return arena.NewNode(vcalc::VCalcParser::PRINT, {expr});
+}
+
+Ast::Node Parser::ParseExpr(int min_precedence, TokenSet expr_follow){
+    Ast::Node left = ParsePrimary(expr_follow);
+    for (int precedence = Precedence(LA(1).type); precedence >= std::max(min_precedence, 1);
+         precedence = Precedence(LA(1).type)){
+        Token operation = LA(1);
+        Advance();
+        if (operation.type == vcalc::VCalcParser::T__2){ // an index, the operand in brackets is a whole expr
+            Ast::Node index_node = arena.NewNode(vcalc::VCalcParser::INDEX);
+            Ast::Node index = ParseExpr(0, Bit(vcalc::VCalcParser::T__3));
+            Match(vcalc::VCalcParser::T__3, expr_operators | expr_follow);
+            left = arena.NewNode(vcalc::VCalcParser::EXPR, {left, index_node, index});
+        }
+        else{ // left associative, the right operand only takes operators that bind tighter
+            Ast::Node operation_node = TokenNode(operation);
+            left = arena.NewNode(vcalc::VCalcParser::EXPR,
+                                 {left, operation_node, ParseExpr(precedence + 1, expr_follow)});
+        }
+    }
+    return left;
+}
+
+Ast::Node Parser::ParsePrimary(TokenSet expr_follow){
+    Token token = LA(1);
+    Ast::Node node;
+    switch (token.type){
+        case vcalc::VCalcParser::T__0: // parentheses only group, there is no node for them
+            Advance();
+            node = ParseExpr(0, Bit(vcalc::VCalcParser::T__1));
+            Match(vcalc::VCalcParser::T__1, expr_operators | expr_follow);
+            return node;
+        case vcalc::VCalcParser::ID:
+        case vcalc::VCalcParser::INT:
+            Advance();
+            return arena.NewNode(vcalc::VCalcParser::EXPR, {TokenNode(token)});
+        case vcalc::VCalcParser::T__2:
+            return ParseGenerator(expr_follow);
+    }
+    if (pending_prediction != SIZE_MAX){
+        FailPrediction();
+    }
+    if (error_recovery){ // ANTLR skips the sync and the prediction fails, the error is not reported
+        Fail(token, "no viable alternative at input " + TokenErrorDisplay(token));
+    }
+    // the sync before the prediction deletes a single extraneous token
+    if (Contains(expr_starts, LA(2).type)){
+        ReportError(token, "extraneous input " + TokenErrorDisplay(token) + " expecting " + ExpectedString(expr_starts));
+        Advance();
+        return ParsePrimary(expr_follow);
+    }
+    Fail(token, "mismatched input " + TokenErrorDisplay(token) + " expecting " + ExpectedString(expr_starts));
+}
+
+Ast::Node Parser::ParseGenerator(TokenSet expr_follow){
+    // whether this is a generator or a filter is only known at the '|' or '&' after the domain
+    bool outermost = pending_prediction == SIZE_MAX;
+    if (outermost){
+        pending_prediction = current;
+        prediction_recovery = error_recovery;
+    }
+    Advance();
+    Token id = LA(1);
+    if (id.type != vcalc::VCalcParser::ID){
+        FailPrediction();
+    }
+    Advance();
+    if (LA(1).type != vcalc::VCalcParser::T__4){
+        FailPrediction();
+    }
+    Advance();
+    Ast::Node domain = ParseExpr(0, 0);
+    size_t kind = LA(1).type;
+    if (kind != vcalc::VCalcParser::T__5 && kind != vcalc::VCalcParser::T__6){
+        FailPrediction();
+    }
+    if (outermost){
+        pending_prediction = SIZE_MAX;
+    }
+    Advance();
+
+    Ast::Node token_node = arena.NewNode(
+        kind == vcalc::VCalcParser::T__5 ? vcalc::VCalcParser::GENERATOR : vcalc::VCalcParser::FILTER,
+        {TokenNode(id)});
+    Ast::Node body = ParseExpr(0, Bit(vcalc::VCalcParser::T__3));
+    Match(vcalc::VCalcParser::T__3, expr_operators | expr_follow);
+    return arena.NewNode(vcalc::VCalcParser::EXPR, {domain, token_node, body});
+}
+
+std::unique_ptr<Ast::AstArena> ParseFile(const std::string &input_path){
+    // like ANTLRFileStream a file that cannot be read is an empty program
+    std::ifstream input(input_path, std::ios::binary);
+    std::stringstream source;
+    source << input.rdbuf();
+    // the tokens point into the lexer's copy of the source, it has to outlive the parser
+    Lexer lexer(source.str());
+    std::unique_ptr<Ast::AstArena> arena = std::make_unique<Ast::AstArena>();
+    Parser parser(lexer.Tokenize(), *arena);
+    arena->SetRoot(parser.ParseFile());
+    return arena;
+}
+
+}
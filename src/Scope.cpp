@@ -2,8 +2,8 @@
 
 namespace Scope{
 
-void BaseScope::Define(std::shared_ptr<Symbol::BaseSymbol> sym){
-    symbols.emplace(sym->GetName(), sym);
+void BaseScope::Define(uint32_t name_id, std::shared_ptr<Symbol::BaseSymbol> sym){
+    symbols.try_emplace(name_id, sym);
     sym->SetScope(shared_from_this());
 }
 
@@ -11,7 +11,7 @@ std::shared_ptr<BaseScope> BaseScope::GetEnclosingScope(){
     return enclosing_scope;
 }
 
-std::map<std::string, std::shared_ptr<Symbol::BaseSymbol>> BaseScope::GetSymbols(){
+const llvm::DenseMap<uint32_t, std::shared_ptr<Symbol::BaseSymbol>> &BaseScope::GetSymbols(){
     return symbols;
 }
 
@@ -19,21 +19,29 @@ void BaseScope::SetEnclosingScope(std::shared_ptr<BaseScope> new_enclosing_scope
     enclosing_scope = new_enclosing_scope;
 }
 
-std::shared_ptr<Symbol::BaseSymbol> BaseScope::Resolve(const std::string &name){
-    auto iterator = symbols.find(name);
+std::shared_ptr<Symbol::BaseSymbol> BaseScope::Resolve(uint32_t name_id){
+    // walks the chain in a loop, scopes nest as deep as the blocks and generators do
+    for (BaseScope *scope = this; scope != nullptr; scope = scope->enclosing_scope.get()){
+        auto iterator = scope->symbols.find(name_id);
+        if (iterator != scope->symbols.end()){
+            return iterator->second;
+        }
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Symbol::BaseSymbol> BaseScope::ResolveLocal(uint32_t name_id){
+    auto iterator = symbols.find(name_id);
     if (iterator != symbols.end()){
         return iterator->second;
     }
-    else if (enclosing_scope != nullptr){
-        return enclosing_scope->Resolve(name);
-    }
     return nullptr;
 }
 
 void BaseScope::PrintScope(){
     std::cout << '[';
     for (auto iterator = symbols.begin(); iterator != symbols.end(); iterator++){
-        std::cout << iterator->first;
+        std::cout << iterator->second->GetName();
         std::cout << ' ';
     }
     std::cout << ']' << std::endl;
@@ -1,36 +1,205 @@
 #include "main.h"
 
-void SetFlags(int argc, char **argv){
-  for (int i = 0; i < argc; i++){
+std::vector<char *> SetFlags(int argc, char **argv){
+  std::vector<char *> positional_args;
+  for (int i = 1; i < argc; i++){
     if (!strcmp(argv[i], "--debug")){
       program_flags |= DEBUG;
     }
+    else if (!strcmp(argv[i], "-O0") || !strcmp(argv[i], "-O1") || !strcmp(argv[i], "-O2") || !strcmp(argv[i], "-O3")){
+      opt_level = argv[i][2] - '0';
+    }
+    else if (!strcmp(argv[i], "--run")){
+      run_jit = true;
+    }
+    else if (!strcmp(argv[i], "--emit=ll") || !strcmp(argv[i], "--emit=obj") || !strcmp(argv[i], "--emit=exe")){
+      emit_kind = argv[i] + strlen("--emit=");
+    }
+    else if (!strcmp(argv[i], "-march=native")){
+      march_native = true;
+    }
+    else if (!strncmp(argv[i], "--emit-prelude=", strlen("--emit-prelude="))){
+      prelude_output = argv[i] + strlen("--emit-prelude=");
+    }
+    else if (!strcmp(argv[i], "--parse-time")){
+      report_parse_time = true;
+    }
+    else if (!strcmp(argv[i], "--frontend=handwritten")){
+      handwritten_frontend = true;
+    }
+    else if (!strcmp(argv[i], "--frontend=antlr")){
+      handwritten_frontend = false;
+    }
+    else if (!strcmp(argv[i], "--dump-ast")){
+      dump_ast = true;
+    }
+    else if (!strcmp(argv[i], "--batch")){
+      batch = true;
+    }
+    else if (!strncmp(argv[i], "--jobs=", strlen("--jobs="))){
+      jobs = atoi(argv[i] + strlen("--jobs="));
+    }
+    else if (!strncmp(argv[i], "--threads=", strlen("--threads="))){
+      num_threads = atoi(argv[i] + strlen("--threads="));
+    }
+    else if (!strncmp(argv[i], "--cache-dir=", strlen("--cache-dir="))){
+      cache_dir = argv[i] + strlen("--cache-dir=");
+    }
+    else if (!strncmp(argv[i], "--cache-size=", strlen("--cache-size="))){
+      cache_size_mib = strtoull(argv[i] + strlen("--cache-size="), nullptr, 10);
+    }
+    else{
+      positional_args.push_back(argv[i]);
+    }
   }
+  return positional_args;
 }
 
-int main(int argc, char **argv) {
-  if (argc < 3) {
-    std::cout << "Missing required argument.\n"
-              << "Required arguments: <input file path> <output file path>\n";
+std::string FindNextToExecutable(const char *argv0, const char *env_var, const char *file_name){
+  if (const char *env_path = getenv(env_var)){
+    return env_path;
+  }
+  std::string executable = llvm::sys::fs::getMainExecutable(argv0, (void *)&FindNextToExecutable);
+  llvm::SmallString<256> path(llvm::sys::path::parent_path(executable));
+  llvm::sys::path::append(path, file_name);
+  if (!llvm::sys::fs::exists(path)){
+    return "";
+  }
+  return std::string(path);
+}
+
+std::string FindRuntimeLibrary(const char *argv0){
+  std::string runtime_path = FindNextToExecutable(argv0, "VCALCRT_PATH", "libvcalcrt.so");
+#ifdef VCALCRT_BUILD_PATH
+  if (runtime_path.empty() && llvm::sys::fs::exists(VCALCRT_BUILD_PATH)){
+    runtime_path = VCALCRT_BUILD_PATH;
+  }
+#endif
+  return runtime_path;
+}
+
+std::string FindPrelude(const char *argv0){
+  return FindNextToExecutable(argv0, "VCALC_PRELUDE", "vcalc_prelude.bc");
+}
+
+std::string CacheOptions(const std::string &runtime_path){
+  std::string options = emit_kind + " -O" + std::to_string(opt_level);
+  if (emit_kind == "exe"){
+    // executables link the runtime by path and keep its directory as their rpath
+    options += " --runtime=" + runtime_path;
+  }
+  if (march_native){
+    // the artifact is only valid for the CPU it was built on
+    options += " -march=" + llvm::sys::getHostCPUName().str();
+  }
+  if (num_threads > 0){
+    options += " --threads=" + std::to_string(num_threads);
+  }
+  return options;
+}
+
+std::string CompilerIdentity(const char *argv0){
+  std::string build = CompileCache::Cache::BuildId();
+  if (build.empty()){
+    // linked without a build id, fall back to where the executable is and when it was written. Hashing it instead
+    // would read all of MLIR and LLVM on every run, cache hits included
+    std::string executable = llvm::sys::fs::getMainExecutable(argv0, (void *)&FindNextToExecutable);
+    llvm::sys::fs::file_status status;
+    if (executable.empty() || llvm::sys::fs::status(executable, status)){
+      return "";
+    }
+    build = executable + " " + std::to_string(status.getSize()) + " " +
+            std::to_string(status.getLastModificationTime().time_since_epoch().count());
+  }
+  // the prelude is small and can be swapped with VCALC_PRELUDE, so its contents are hashed
+  std::string prelude = CompileCache::Cache::HashFiles({FindPrelude(argv0)});
+  if (prelude.empty()){
+    return "";
+  }
+  return build + " " + prelude;
+}
+
+int LinkExecutable(const std::string &object_path, const std::string &output_path, const std::string &runtime_path){
+  llvm::ErrorOr<std::string> driver = llvm::sys::findProgramByName("cc");
+  if (!driver){
+    driver = llvm::sys::findProgramByName("clang");
+  }
+  if (!driver){
+    llvm::errs() << "Could not find cc or clang to link with\n";
     return 1;
   }
-  SetFlags(argc, argv);
+  std::vector<std::string> args = {*driver, object_path, "-o", output_path};
+  if (!runtime_path.empty()){
+    // link the shared library by path and remember where it is so the executable runs from anywhere
+    std::string runtime_dir = llvm::sys::path::parent_path(runtime_path).str();
+    args.push_back(runtime_path);
+    args.push_back("-Wl,-rpath," + runtime_dir);
+  }
+  std::vector<llvm::StringRef> arg_refs(args.begin(), args.end());
+  std::string error;
+  int result = llvm::sys::ExecuteAndWait(*driver, arg_refs, std::nullopt, {}, 0, 0, &error);
+  if (result != 0){
+    llvm::errs() << "Linking failed" << (error.empty() ? "" : ": " + error) << "\n";
+    return 1;
+  }
+  return 0;
+}
+
+std::unique_ptr<Ast::AstArena> BuildAst(const std::string &input_path){
+  auto parse_start = std::chrono::steady_clock::now();
+  if (handwritten_frontend){
+    std::unique_ptr<Ast::AstArena> AstTree = FrontEnd::ParseFile(input_path);
+    if (report_parse_time){
+      std::chrono::duration<double, std::milli> parse_time = std::chrono::steady_clock::now() - parse_start;
+      std::cerr << input_path << ": parsed in " << parse_time.count() << " ms (handwritten)\n";
+    }
+    return AstTree;
+  }
 
   // Open the file then parse and lex it.
   antlr4::ANTLRFileStream afs;
-  afs.loadFromFile(argv[1]);
+  afs.loadFromFile(input_path);
   vcalc::VCalcLexer lexer(&afs);
   antlr4::CommonTokenStream tokens(&lexer);
   vcalc::VCalcParser parser(&tokens);
 
   // Get the root of the parse tree. Use your base rule name.
-  antlr4::tree::ParseTree *tree = parser.file();
-  AstBuilder::AstBuild tree_builder;
-  std::shared_ptr<Ast::AstNode> AstTree = std::any_cast<std::shared_ptr<Ast::AstNode>>(tree_builder.visit(tree));
+  // SLL prediction is much cheaper on the left recursive expr rule and accepts almost every valid program, it
+  // bails out on the first error instead of reporting it. Only then is the input parsed again with full LL, which
+  // gives the same result and error messages as before.
+  antlr4::tree::ParseTree *tree = nullptr;
+  const char *prediction_mode = "SLL";
+  parser.getInterpreter<antlr4::atn::ParserATNSimulator>()->setPredictionMode(antlr4::atn::PredictionMode::SLL);
+  parser.removeErrorListeners();
+  parser.setErrorHandler(std::make_shared<antlr4::BailErrorStrategy>());
+  try {
+    tree = parser.file();
+  }
+  catch (const antlr4::ParseCancellationException &){
+    prediction_mode = "LL";
+    tokens.seek(0);
+    parser.reset();
+    parser.addErrorListener(&antlr4::ConsoleErrorListener::INSTANCE);
+    parser.setErrorHandler(std::make_shared<antlr4::DefaultErrorStrategy>());
+    parser.getInterpreter<antlr4::atn::ParserATNSimulator>()->setPredictionMode(antlr4::atn::PredictionMode::LL);
+    tree = parser.file();
+  }
+  if (report_parse_time){
+    std::chrono::duration<double, std::milli> parse_time = std::chrono::steady_clock::now() - parse_start;
+    std::cerr << input_path << ": parsed in " << parse_time.count() << " ms (" << prediction_mode << ")\n";
+  }
+  std::unique_ptr<Ast::AstArena> AstTree = std::make_unique<Ast::AstArena>();
+  AstBuilder::AstBuild tree_builder(*AstTree);
+  AstTree->SetRoot(Ast::Node(AstTree.get(), std::any_cast<Ast::NodeId>(tree_builder.visit(tree))));
+  return AstTree;
+}
+
+std::unique_ptr<Ast::AstArena> ParseFile(const std::string &input_path){
+  std::unique_ptr<Ast::AstArena> AstTree = BuildAst(input_path);
 
   if (program_flags & DEBUG){
     AstVisitor::AstDebugger walker;
-    walker.DfsTraversal(AstTree);
+    walker.DfsTraversal(AstTree->GetRoot());
   }
 
   if (program_flags & DEBUG){
@@ -38,16 +207,222 @@ int main(int argc, char **argv) {
   }
 
   AstVisitor::DefRef def_ref_visitor;
-  def_ref_visitor.Visit(AstTree);
+  def_ref_visitor.Visit(AstTree->GetRoot());
   if (program_flags & DEBUG){
     std::cout << "Scope Tree Built and Types Validated" << std::endl << std::endl;
   }
-  AstVisitor::CodeGen code_gen_visitor;
-  code_gen_visitor.GenerateMlir(true, AstTree);
-  std::ofstream os(argv[2]);
-  code_gen_visitor.lowerDialects();
+  AstVisitor::ConstantFolder constant_folder;
+  constant_folder.Visit(AstTree->GetRoot());
+  if (program_flags & DEBUG){
+    std::cout << "Constants Folded" << std::endl << std::endl;
+  }
+
+  AstVisitor::LengthInference length_inference;
+  length_inference.Infer(AstTree->GetRoot());
+  return AstTree;
+}
+
+int EmitArtifact(AstVisitor::CodeGen &code_gen_visitor, const std::string &output_path, const std::string &runtime_path){
+  if (code_gen_visitor.translateToLLVM() || code_gen_visitor.optimizeLLVM(opt_level)){
+    return 1;
+  }
+  if (emit_kind == "obj"){
+    return code_gen_visitor.emitObject(output_path);
+  }
+  if (emit_kind == "exe"){
+    // the object only lives until it is linked
+    llvm::SmallString<256> object_path;
+    if (llvm::sys::fs::createTemporaryFile("vcalc", "o", object_path)){
+      llvm::errs() << "Could not create a temporary object file\n";
+      return 1;
+    }
+    int failed = code_gen_visitor.emitObject(std::string(object_path)) ||
+                 LinkExecutable(std::string(object_path), output_path, runtime_path);
+    llvm::sys::fs::remove(object_path);
+    return failed;
+  }
+  std::ofstream os(output_path);
   code_gen_visitor.dumpLLVM(os);
+  os.close();
+  return 0;
+}
+
+int CompileFile(AstVisitor::CodeGen &code_gen_visitor, const std::string &input_path, const std::string &output_path,
+                const std::string &runtime_path, bool dump){
+  // a cached artifact for the same source and flags is emitted without running any compiler phase
+  CompileCache::Cache cache(cache_dir, cache_size_mib << 20);
+  std::string cache_key;
+  if (!cache_dir.empty()){
+    // an unreadable input must not hash as the empty program and hit its artifact
+    llvm::ErrorOr<std::unique_ptr<llvm::MemoryBuffer>> source = llvm::MemoryBuffer::getFile(input_path);
+    if (!source){
+      throw std::runtime_error("Could not read " + input_path + ": " + source.getError().message());
+    }
+    cache_key = CompileCache::Cache::Key(compiler_identity, (*source)->getBuffer().str(), CacheOptions(runtime_path));
+    if (cache.Fetch(cache_key, output_path)){
+      return 0;
+    }
+  }
+
+  std::unique_ptr<Ast::AstArena> AstTree = ParseFile(input_path);
+  code_gen_visitor.GenerateMlir(dump, AstTree->GetRoot());
+  if (code_gen_visitor.lowerDialects() || EmitArtifact(code_gen_visitor, output_path, runtime_path)){
+    return 1;
+  }
 
+  if (!cache_key.empty()){
+    cache.Store(cache_key, output_path);
+  }
   return 0;
-  
+}
+
+std::vector<std::pair<std::string, std::string>> BatchFiles(const std::vector<char *> &args){
+  std::vector<std::pair<std::string, std::string>> files;
+  if (args.size() == 1){
+    std::ifstream list(args[0]);
+    if (!list){
+      throw std::runtime_error(std::string("Could not open batch list ") + args[0]);
+    }
+    std::string line;
+    while (std::getline(list, line)){
+      std::istringstream fields(line);
+      std::string input_path, output_path;
+      if (!(fields >> input_path)){
+        continue;
+      }
+      if (!(fields >> output_path)){
+        throw std::runtime_error("Batch list line without an output path: " + line);
+      }
+      files.emplace_back(input_path, output_path);
+    }
+    return files;
+  }
+  if (args.size() % 2){
+    throw std::runtime_error("--batch takes a list file or input/output path pairs");
+  }
+  for (size_t i = 0; i < args.size(); i += 2){
+    files.emplace_back(args[i], args[i + 1]);
+  }
+  return files;
+}
+
+int CompileBatch(const std::vector<std::pair<std::string, std::string>> &files, const std::string &prelude_path,
+                 const std::string &runtime_path){
+  // every worker creates its target machine, register the targets once up front
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+
+  size_t worker_count = jobs > 0 ? jobs : std::max(1u, std::thread::hardware_concurrency());
+  worker_count = std::min(worker_count, files.size());
+  std::atomic<size_t> next_file(0);
+  // empty while the file compiled, otherwise why it did not
+  std::vector<std::string> errors(files.size());
+
+  std::vector<std::thread> workers;
+  for (size_t worker = 0; worker < worker_count; worker++){
+    workers.emplace_back([&](){
+      // the context, dialects and helper functions are set up once per worker and reset between files
+      AstVisitor::CodeGen code_gen_visitor(prelude_path, true);
+      if (march_native){
+        code_gen_visitor.UseHostCPU();
+      }
+      code_gen_visitor.SetNumThreads(num_threads);
+      bool fresh = true;
+      for (size_t file = next_file++; file < files.size(); file = next_file++){
+        if (!fresh){
+          code_gen_visitor.Reset();
+        }
+        fresh = false;
+        try {
+          if (CompileFile(code_gen_visitor, files[file].first, files[file].second, runtime_path, program_flags & DEBUG)){
+            errors[file] = "compilation failed";
+          }
+        }
+        catch (const std::exception &error){
+          errors[file] = error.what();
+        }
+      }
+    });
+  }
+  for (std::thread &worker : workers){
+    worker.join();
+  }
+
+  size_t failed = 0;
+  for (size_t file = 0; file < files.size(); file++){
+    if (!errors[file].empty()){
+      std::cerr << files[file].first << ": " << errors[file] << "\n";
+      failed++;
+    }
+  }
+  if (failed){
+    std::cerr << failed << " of " << files.size() << " files failed to compile\n";
+  }
+  return failed ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  std::vector<char *> args = SetFlags(argc, argv);
+  if (!prelude_output.empty()){
+    // built at build time, this BackEnd has no prelude so it builds the helpers
+    BackEnd prelude_backend;
+    return prelude_backend.emitPrelude(prelude_output);
+  }
+  if (args.size() < (run_jit || batch || dump_ast ? 1 : 2) || (run_jit && batch)) {
+    std::cout << "Missing required argument.\n"
+              << "Required arguments: <input file path> <output file path>\n"
+              << "                or: --run <input file path>\n"
+              << "                or: --batch <list file> | --batch <input> <output> [<input> <output> ...]\n"
+              << "                or: --dump-ast <input file path>\n"
+              << "Optional arguments: --debug, -O0, -O1, -O2, -O3, --emit=ll|obj|exe, -march=native,\n"
+              << "                    --threads=<n>, --jobs=<n>, --cache-dir=<dir>, --cache-size=<MiB>, --parse-time,\n"
+              << "                    --frontend=antlr|handwritten\n";
+    return 1;
+  }
+
+  if (dump_ast){
+    // only the parser's output, before any pass, so the two frontends can be compared
+    FrontEnd::DumpAst(BuildAst(args[0])->GetRoot(), std::cout);
+    return 0;
+  }
+
+  if (!cache_dir.empty() && !run_jit){
+    // found once up front, batch workers only read it
+    compiler_identity = CompilerIdentity(argv[0]);
+    if (compiler_identity.empty()){
+      std::cerr << "Could not identify the vcalc build or read its prelude, the compile cache is disabled\n";
+      cache_dir.clear();
+    }
+  }
+
+  std::string runtime_path = FindRuntimeLibrary(argv[0]);
+  if (runtime_path.empty() && (run_jit || emit_kind == "exe")){
+    // the program still runs, printing through printf, but without the SIMD kernels and the thread pool
+    std::cerr << "Could not find libvcalcrt.so, set VCALCRT_PATH to it. Running without the vcalc runtime\n";
+  }
+
+  if (batch){
+    return CompileBatch(BatchFiles(args), FindPrelude(argv[0]), runtime_path);
+  }
+
+  AstVisitor::CodeGen code_gen_visitor(FindPrelude(argv[0]));
+  if (march_native){
+    code_gen_visitor.UseHostCPU();
+  }
+  code_gen_visitor.SetNumThreads(num_threads);
+  if (!run_jit){
+    return CompileFile(code_gen_visitor, args[0], args[1], runtime_path, true);
+  }
+
+  // --run executes in process so there is nothing to cache. The program's output goes to stdout through
+  // vcalcrt's write buffer, so the compiler's own --debug traces go to stderr instead
+  std::cout.rdbuf(std::cerr.rdbuf());
+  std::unique_ptr<Ast::AstArena> AstTree = ParseFile(args[0]);
+  code_gen_visitor.GenerateMlir(program_flags & DEBUG, AstTree->GetRoot());
+  if (code_gen_visitor.lowerDialects()){
+    return 1;
+  }
+  // run main right away instead of going through llc, clang and a new process
+  return code_gen_visitor.runJIT(opt_level, runtime_path);
+
 }
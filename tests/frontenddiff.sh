@@ -0,0 +1,41 @@
+#!/bin/bash
+# Differential test of the hand written frontend against the ANTLR one. Every input is parsed by both with
+# --dump-ast, the ASTs have to be the same and so does the first syntax error reported.
+# Usage: ./frontenddiff.sh [vcalc executable] [input files...], by default ../bin/vcalc on every test input
+
+VCALC=${1:-../bin/vcalc}
+shift
+FILES=("$@")
+if [ ${#FILES[@]} -eq 0 ] ; then
+    FILES=(./testfiles/*/*.txt)
+fi
+
+TMP_DIR=$(mktemp -d)
+trap 'rm -rf "$TMP_DIR"' EXIT
+
+failed=0
+for file in "${FILES[@]}"
+do
+    "$VCALC" --dump-ast "$file" > "$TMP_DIR/antlr.out" 2> "$TMP_DIR/antlr.err"
+    antlr_status=$?
+    "$VCALC" --dump-ast --frontend=handwritten "$file" > "$TMP_DIR/handwritten.out" 2> "$TMP_DIR/handwritten.err"
+    handwritten_status=$?
+
+    # the first error has to match, after an error ANTLR may recover where the hand written parser stops
+    if [ "$(head -n 1 "$TMP_DIR/antlr.err")" != "$(head -n 1 "$TMP_DIR/handwritten.err")" ] ; then
+        echo "$file: syntax errors differ"
+        diff "$TMP_DIR/antlr.err" "$TMP_DIR/handwritten.err"
+        failed=$((failed + 1))
+    elif [ $antlr_status -eq 0 ] && [ $handwritten_status -eq 0 ] && \
+         ! diff -q "$TMP_DIR/antlr.out" "$TMP_DIR/handwritten.out" > /dev/null ; then
+        echo "$file: ASTs differ"
+        diff "$TMP_DIR/antlr.out" "$TMP_DIR/handwritten.out" | head -n 20
+        failed=$((failed + 1))
+    elif [ ! -s "$TMP_DIR/antlr.err" ] && [ $antlr_status -ne $handwritten_status ] ; then
+        echo "$file: exit status $antlr_status with ANTLR but $handwritten_status hand written"
+        failed=$((failed + 1))
+    fi
+done
+
+echo "${#FILES[@]} files compared, $failed differ"
+[ $failed -eq 0 ]